@@ -0,0 +1,45 @@
+/*
+    Image assets used with Object.setShape(@NAME).
+
+    Every image a script refers to is loaded once before the script starts (NAME.bmp or NAME.ppm next to the script file),
+    converted to the screen's pixel format and stored in one shared atlas. Pure magenta (255, 0, 255) pixels are transparent,
+    so each row of an image is stored as a list of opaque runs that can be copied straight into the screen buffer.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "screen.hpp"
+
+//biggest image (in either direction) Squiggly will load
+#define MAX_IMAGE_SIZE 4096
+
+namespace Assets {
+    //horizontal run of opaque pixels in one row of an image
+    typedef struct {
+        uint16_t x;
+        uint16_t length;
+    } Run;
+
+    typedef struct {
+        std::string name;
+        int width;
+        int height;
+        size_t pixels; //index of the first pixel in the atlas (rows are stored one after another)
+        size_t rows;   //index of the first row in the run table (runs of row y are rowStarts[rows+y] to rowStarts[rows+y+1])
+    } Image;
+
+    //find every @NAME in the script and load the images that exist in directory (replaces anything loaded before)
+    void load(const std::vector<std::string>& lines, const std::string& directory);
+    void clear();
+
+    //index of a loaded image, -1 if there is no image with that name
+    int find(const std::string& name);
+    const Image& get(int image);
+
+    const pixel_t* rowPixels(const Image& img, int y);
+    const Run* rowRuns(const Image& img, int y, size_t& count);
+}
@@ -5,13 +5,21 @@
 #include <vector>
 
 #include "utils.hpp"
+#include "font.hpp"
 
 //default values when new objects are initialized
 #define OBJ_DEF_WIDTH 10
 #define OBJ_DEF_HEIGHT 10
 
-//how many times will the engine attempt to move the object back out of a collision (breaks distance between old and new position into discrete segments). The higher this number, the more loops per collision
-#define OBJ_COL_RESP_SEGMENTS 15
+//default values when new text variables are initialized
+#define TEXT_DEF_SCALE 1
+
+//default size (in pixels) of a tilemap's tiles before a tileset is picked
+#define TILEMAP_DEF_TILE_SIZE 16
+
+//limits on tilemaps: biggest tile, and most cells one map can have
+#define MAX_TILE_SIZE 256
+#define MAX_TILEMAP_CELLS (1 << 24)
 
 /*
     All of the built-in functions and objects that come with Squiggly
@@ -34,16 +42,36 @@ namespace BuiltIn
     void GenRandNum(int min, int max);
     void GenRandNum();
 
-    enum ObjectShape { //not implemented yet
+    enum ObjectShape {
         RECT,
         TRIANGLE,
         ELLIPSE,
+        IMAGE, //loaded image asset (see assets.hpp)
     };
 
+    //where an object is, worked out from its x/y/width/height/rotation and kept until one of them changes (see Object::getTransform)
+    typedef struct {
+        float x, y, width, height, rotation; //values everything below was worked out from
+        float sine, cosine;                  //of the rotation (exact for multiples of 90 degrees)
+
+        //physics box: whole pixel center and half size, its corners and the half size of the axis aligned box around it
+        int cx, cy;
+        int halfW, halfH;
+        float corners[4][2];                 //top right, top left, bottom left, bottom right (before rotating)
+        float extentX, extentY;
+
+        int minX, minY, maxX, maxY;          //every pixel drawing the object's shape can touch
+    } Transform;
+
     //built in class types
     class Object {
         public:
             Object();
+            ~Object();
+
+            //objects are tracked by address (walls, broadphase), so they are never copied
+            Object(const Object&) = delete;
+            Object& operator=(const Object&) = delete;
 
             size_t id;
 
@@ -52,6 +80,7 @@ namespace BuiltIn
             float getWidth();
             float getHeight();
             float getRotation();
+            const Transform& getTransform(); //only recalculated if one of the values it depends on changed since the last call
             void getColor(uint8_t buffer[3]);
 
             void setX(float v);
@@ -61,13 +90,33 @@ namespace BuiltIn
             void setRotation(float v);
 
             ObjectShape shape;
+            int image; //asset index when shape is IMAGE
             bool solid;
+            int drawLayer; //objects on higher layers are drawn on top of lower ones
+            bool isStatic; //drawn to the cached static layer under everything else (see Screen::flush)
+            bool isBody;   //moved by its velocity every frame (see Physics::step)
+
+            //collision groups: each bit is a layer. Two objects only collide when each one is on a layer the other's mask has
+            uint32_t collisionLayer;
+            uint32_t collisionMask;
+            bool collidesWith(const Object& other) const {
+                return (collisionLayer & other.collisionMask) && (other.collisionLayer & collisionMask);
+            }
+
+            //broadphase bookkeeping, only used by Physics (see Physics::nearby)
+            bool tracked;                 //in the broadphase yet (not until the constructor is done)
+            int gridCells[4];             //first column, first row, last column, last row of the grid cells it is in (gridCells[0] is -1 when in none)
+            bool gridMoved;               //waiting for Physics to check which cells it belongs in
+            unsigned long long nearStamp; //last broadphase query that found it
 
             void callFunction(std::string name, std::vector<std::string>& args);
             Utils::SVariable* fetchVariable(std::string name);
 
             void setColor(uint8_t r, uint8_t g, uint8_t b);
 
+            //move by velocity over dt seconds (after applying acceleration and damping), colliding with and sliding along walls
+            void step(float dt);
+
             static size_t obj_count; //for determining unique id values for each object
 
         private:
@@ -82,19 +131,102 @@ namespace BuiltIn
             Utils::SVariable color_g;
             Utils::SVariable color_b;
 
+            //motion of physics bodies, in pixels per second (and per second squared for acceleration). damping is the fraction
+            //of the velocity lost every second
+            Utils::SVariable vel_x;
+            Utils::SVariable vel_y;
+            Utils::SVariable acc_x;
+            Utils::SVariable acc_y;
+            Utils::SVariable damping;
+
             void draw();
             bool isTouching(Object& other);
             void setObjShape(std::string img);
-            void move(float x, float y, bool collide);
+            void move(float x, float y, bool collide, bool slide);
+            Object* touchingWall(unsigned long long near);
             void addWall(Object* wall, bool add);
 
             std::vector<Object*> walls; //all the object IDs in the scene that this object is a wall for
 
+            Transform transform;
+            void updateTransform();
+
             //pointers to variables in main memory that objects will need access to
             bool* collisionFlag;
     };
 
-    class Text { 
-        //TODO: this still needs to be implemented lol
+    //string drawn on screen with the built in font (see font.hpp). x and y are the top left corner of the text
+    class Text {
+        public:
+            Text();
+
+            float getX();
+            float getY();
+            void getColor(uint8_t buffer[3]);
+            void setColor(uint8_t r, uint8_t g, uint8_t b);
+
+            int scale; //every pixel of the font is drawn as a scale x scale square
+            int drawLayer;
+            bool isStatic;
+
+            //glyphs for the current text, only laid out again when the text changed since the last call. width/height are unscaled
+            const std::vector<Font::Placement>& getGlyphs(int& width, int& height);
+
+            void callFunction(std::string name, std::vector<std::string>& args);
+            Utils::SVariable* fetchVariable(std::string name);
+
+        private:
+            //accessible from Squiggly scripts
+            Utils::SVariable x;
+            Utils::SVariable y;
+            Utils::SVariable text;
+
+            Utils::SVariable color_r;
+            Utils::SVariable color_g;
+            Utils::SVariable color_b;
+
+            void draw();
+
+            //layout of laidOut (the text the last time it was drawn)
+            std::vector<Font::Placement> glyphs;
+            std::string laidOut;
+            int layoutWidth;
+            int layoutHeight;
+    };
+
+    //grid of tiles cut from a tileset image. Tile 0 is empty, tile n is the nth tile of the tileset (left to right, top to bottom).
+    //World coordinate (scroll_x, scroll_y) is drawn at the top left corner of the screen
+    class Tilemap {
+        public:
+            Tilemap();
+
+            float getScrollX();
+            float getScrollY();
+
+            int columns;
+            int rows;
+            int tileSize;
+            int tileset; //asset index of the tileset image (-1 until one is picked)
+            int drawLayer;
+
+            //tile index of every cell, row by row
+            std::vector<uint16_t> cells;
+
+            //tile at a world coordinate (0 outside of the map)
+            int tileAt(float x, float y);
+
+            void callFunction(std::string name, std::vector<std::string>& args);
+            Utils::SVariable* fetchVariable(std::string name);
+
+        private:
+            //accessible from Squiggly scripts
+            Utils::SVariable scroll_x;
+            Utils::SVariable scroll_y;
+
+            void draw();
+            void setTiles(int column, int row, int width, int height, int tile);
+
+            //return value bucket in main memory (for getTile)
+            int* intReturn;
     };
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+/*
+    Frame capture (--capture <folder>): every presented frame is saved as a numbered PNG file in the folder.
+
+    The present thread only copies each frame into one of a few preallocated buffers, which are turned into PNG files by a
+    writer thread of their own, so capturing never slows down the script. If the writer falls behind and every buffer is
+    still waiting to be written, the frame is dropped (and counted) instead of waiting for a buffer to free up. Files are
+    numbered by presented frame, so dropped frames show up as gaps in the numbering.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "screen.hpp"
+
+//frames that can be waiting for the writer thread at once
+#define CAPTURE_BUFFERS 8
+
+namespace Capture {
+    //start capturing every presented frame to folder (made if it doesn't exist yet). Buffers are sized for the current resolution
+    void start(const std::string& folder);
+    //write out the frames still waiting, join the writer thread and print how many frames were saved and dropped
+    void stop();
+
+    //called by the present thread for every frame it presents. Never waits on the writer thread
+    void frame(const FrameView& view);
+}
@@ -0,0 +1,51 @@
+/*
+    Built in bitmap font used by TEXT variables.
+
+    The font is a 5x7 pixel ASCII font compiled into Squiggly. When a script starts every glyph is rasterized into an atlas of
+    horizontal runs, so drawing text is just filling those runs (scaled up for bigger text) instead of working out each
+    character's pixels every frame. Laying out a string (turning it into glyphs and positions) is done once per string
+    and kept by the TEXT variable until its text changes.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define FONT_FIRST_CHAR 32  //' '
+#define FONT_LAST_CHAR 126  //'~'
+#define FONT_UNKNOWN_CHAR '?' //drawn for any character the font doesn't have
+
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define GLYPH_ADVANCE 6 //distance from one character to the next (glyph plus one pixel of spacing)
+#define LINE_ADVANCE 9  //distance from one line of text to the next
+
+//biggest scale text can be drawn at
+#define MAX_TEXT_SCALE 16
+
+namespace Font {
+    //horizontal run of set pixels [x0, x1] on row y of a glyph
+    typedef struct {
+        uint8_t y;
+        uint8_t x0;
+        uint8_t x1;
+    } Run;
+
+    //one character of laid out text: which glyph, and where its top left corner is (unscaled, from the top left of the text)
+    typedef struct {
+        uint8_t glyph;
+        int16_t x;
+        int16_t y;
+    } Placement;
+
+    //rasterize the font into the atlas (only does anything the first time)
+    void init();
+
+    //turn a string into glyph placements. Spaces don't get a placement, '\n' starts a new line. width/height are the unscaled size
+    void layout(const std::string& text, std::vector<Placement>& out, int& width, int& height);
+
+    //runs of a glyph in the atlas, sorted by row
+    const Run* glyphRuns(uint8_t glyph, size_t& count);
+}
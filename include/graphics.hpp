@@ -1,6 +1,10 @@
 #pragma once
 
+#include <vector>
+#include <functional>
+
 #include "screen.hpp"
+#include "font.hpp"
 
 namespace SGraphics {
     typedef struct {
@@ -14,9 +18,36 @@ namespace SGraphics {
         uint8_t b;
     } Color;
 
-    void draw_rect(pixel loc, int width, int height, float rot, Color color, bool fill=false);
-    void draw_triangle(pixel loc, int width, int height, float rot, Color color, bool fill=false);
+    //pixels [x0, x1] of row y
+    typedef struct {
+        int y;
+        int x0;
+        int x1;
+    } span;
+
+    //sin and cos of a rotation, worked out once per shape (objects keep theirs cached, see BuiltIn::Transform)
+    typedef struct {
+        float sine;
+        float cosine;
+    } rotation;
+
+    rotation make_rotation(float rot); //rot in degrees. Multiples of 90 degrees come out exact
+
+    void draw_rect(pixel loc, int width, int height, rotation rot, Color color, bool fill=false);
+    void draw_triangle(pixel loc, int width, int height, rotation rot, Color color, bool fill=false);
     void draw_ellipse(pixel loc, int width, int height, float rot, Color color, bool fill=false);
     void draw_polygon(pixel one, pixel two, pixel three, Color color, bool fill=false);
     void draw_line(pixel one, pixel two, Color color);
+    void draw_image(pixel loc, int image);
+    void draw_text(pixel loc, const Font::Placement* glyphs, size_t count, int scale, Color color);
+    void draw_points(const DrawPoint* points, size_t count, int size);
+    void draw_tiles(pixel loc, const TileWindow& window, const uint16_t* cells);
+
+    //capture the spans of a shape once (see shape-cache.hpp) and fill them again later in any color
+    void record_spans(std::vector<span>& out, const std::function<void(pixel loc)>& draw);
+    void draw_spans(pixel loc, const std::vector<span>& spans, Color color);
+
+    //limit drawing on the calling thread to a box of the screen (inclusive coordinates). Used to split a frame between render workers
+    void set_clip(int x0, int y0, int x1, int y1);
+    void reset_clip();
 }
\ No newline at end of file
@@ -4,12 +4,25 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
 
 #include "tokenizer.hpp"
 #include "runner.hpp"
 #include "linter.hpp"
+#include "workers.hpp"
+#include "assets.hpp"
+#include "screen.hpp"
+#include "capture.hpp"
+
+//options that can be passed after the filename
+unsigned int renderThreads = 0; //--threads: how many threads rasterize each frame (0 = one per cpu core)
+std::string captureFolder = "";  //--capture: folder every presented frame is saved to as a PNG file (empty = no capture)
+
+std::string scriptDir = ""; //folder of the script being run (images are loaded from here)
 
 int parse_args(int argc, char** argv, std::vector<std::string>& fileLines);
+int parse_options(int argc, char** argv, int first);
 int read_file(char* path, std::vector<std::string>& fileLines);
 int run_squiggly(std::vector<std::string>& fileLines);
 
@@ -29,6 +42,11 @@ int parse_args(int argc, char** argv, std::vector<std::string>& fileLines) {
         std::cout << " - Run program: squiggly <filename>" << std::endl;
         std::cout << " - Print template: squiggly template" << std::endl;
         std::cout << std::endl;
+        std::cout << "Options: " << std::endl;
+        std::cout << " - --threads <count>: number of threads used to draw each frame (default: one per cpu core, at most " << MAX_RENDER_THREADS << ")" << std::endl;
+        std::cout << " - --res <width>x<height>: resolution frames are drawn at (default: " << DEFAULT_SCREEN_WIDTH << "x" << DEFAULT_SCREEN_HEIGHT << ")" << std::endl;
+        std::cout << " - --capture <folder>: save every frame to the folder as numbered PNG files" << std::endl;
+        std::cout << std::endl;
         std::cout << "Stuck? Check out some example scripts: " << std::endl;
         std::cout << "https://github.com/CodeSample15/Squiggly/tree/main/test_scripts" << std::endl;
         return 2;
@@ -40,9 +58,50 @@ int parse_args(int argc, char** argv, std::vector<std::string>& fileLines) {
         return 2;
     }
 
+    //optional arguments after the filename
+    if(parse_options(argc, argv, 2))
+        return 1;
+
     return read_file(argv[1], fileLines);
 }
 
+/*
+    Read the options in argv[first] onward (after the filename on pc, every argument on the console, which picks scripts
+    from its menu instead)
+*/
+int parse_options(int argc, char** argv, int first) {
+    for(int i=first; i<argc; i++) {
+        if(strcmp(argv[i], "--threads")==0 && i+1<argc) {
+            char* end = nullptr;
+            long count = strtol(argv[++i], &end, 10);
+            if(end == argv[i] || *end != '\0' || count < 0) {
+                std::cout << "Invalid thread count \'" << argv[i] << "\' (expected a whole number, 0 for one per cpu core). Exiting..." << std::endl;
+                return 1;
+            }
+            renderThreads = (unsigned int)std::min(count, (long)MAX_RENDER_THREADS); //too big for a long comes back as LONG_MAX
+        } else if(strcmp(argv[i], "--res")==0 && i+1<argc) {
+            #if BUILD_FOR_RASPI
+            std::cout << "The console always draws at the panel's resolution, --res can't be used here. Exiting..." << std::endl;
+            return 1;
+            #endif
+
+            int w = 0, h = 0;
+            if(sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w < 1 || h < 1 || w > MAX_SCREEN_SIZE || h > MAX_SCREEN_SIZE) {
+                std::cout << "Invalid resolution \'" << argv[i] << "\' (expected <width>x<height>, at most " << MAX_SCREEN_SIZE << " in either direction). Exiting..." << std::endl;
+                return 1;
+            }
+            screen.setResolution(w, h);
+        } else if(strcmp(argv[i], "--capture")==0 && i+1<argc) {
+            captureFolder = argv[++i];
+        } else {
+            std::cout << "Unknown option \'" << argv[i] << "\'. Exiting..." << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 int read_file(char* path, std::vector<std::string>& fileLines) {
     //attempt to open and then read from file
     std::ifstream file;
@@ -52,6 +111,10 @@ int read_file(char* path, std::vector<std::string>& fileLines) {
         return 1;
     }
 
+    std::string pathStr = path;
+    size_t slash = pathStr.find_last_of("/\\");
+    scriptDir = slash == std::string::npos ? "" : pathStr.substr(0, slash+1);
+
     //read from the input file
     std::string temp;
     while(std::getline(file, temp)) {
@@ -76,6 +139,14 @@ int run_squiggly(std::vector<std::string>& fileLines) {
     //preprocess raw strings
     Linter::preprocess(fileLines);
 
+    //load images the script refers to (before the tokenizer clears out the file lines)
+    try {
+        Assets::load(fileLines, scriptDir);
+    } catch(const std::exception& e) {
+        std::cerr << "\n" << e.what() << std::endl;
+        return 0;
+    }
+
     //Run tokenizer
     try {
         Tokenizer::tokenize(fileLines);
@@ -86,11 +157,17 @@ int run_squiggly(std::vector<std::string>& fileLines) {
 
     //Execute script (stored in tokenizer)
     try {
+        if(!captureFolder.empty())
+            Capture::start(captureFolder);
+
         Runner::execute();
     } catch(const std::exception& e) {
         std::cerr << "\n" << e.what() << std::endl;
     }
 
+    //the present thread is stopped by now, so no more frames are coming in
+    Capture::stop();
+
     std::cout << "Program stopped successfully" << std::endl;
 
     return 0;
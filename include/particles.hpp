@@ -0,0 +1,72 @@
+/*
+    Native particle emitters used through the ^PARTICLES_ built in functions.
+
+    Effects like sparks, smoke or trails need hundreds or thousands of tiny short lived things on screen, which is far too
+    many to be OBJECT variables moved and drawn by a script loop. An emitter keeps its particles in one flat array per value
+    (position, velocity, age, lifetime and color), so moving every particle each frame is a few simple loops over floats the
+    compiler can vectorize. Dead particles are dropped right after moving, and the live ones are always packed at the front.
+    Drawing an emitter copies the positions of its particles into the display list like any other draw.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "screen.hpp"
+
+//most particles one emitter can hold (anything emitted past this is dropped)
+#define MAX_PARTICLES 65536
+
+//biggest particle (in pixels across) an emitter can draw
+#define MAX_PARTICLE_SIZE 8
+
+//particles are moved this many at a time. Buffers are padded to a whole number of blocks, so there is never a leftover tail
+//to handle one particle at a time (and the compiler can use vector instructions without any extra flags)
+#define PARTICLE_BLOCK 8
+
+namespace Particles {
+    typedef struct {
+        //one entry per particle, only [0, count) are alive (the rest of the last block is moved too, but never drawn)
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> vx;
+        std::vector<float> vy;
+        std::vector<float> age;  //seconds since the particle was emitted
+        std::vector<float> life; //seconds the particle lives for
+        std::vector<pixel_t> color;
+        size_t count;
+        size_t capacity; //0 for a freed emitter
+
+        //what new particles start out with. Angles are in degrees, 0 points right and 90 points down the screen
+        float speedMin, speedMax; //pixels per second
+        float angle;              //direction particles are sent in
+        float spread;             //particles go out up to spread/2 degrees either side of angle (360 is every direction)
+        float lifeMin, lifeMax;
+        pixel_t emitColor;
+
+        float gravityX, gravityY; //acceleration of every particle in pixels per second squared
+        int size;                 //particles are size x size squares centered on their position
+
+        uint32_t seed; //random number state (each emitter has its own, so emitting doesn't touch rand())
+    } Emitter;
+
+    //make a new emitter that can hold up to capacity particles, returns its id (reusing the id of a freed emitter if there is one)
+    int create(int capacity);
+
+    //free an emitter's particle buffers. Its id can be handed out again by create
+    void destroy(Emitter& e);
+
+    //emitter with this id, nullptr if there isn't one (or it was freed)
+    Emitter* get(int id);
+
+    void emit(Emitter& e, int count, float x, float y);
+
+    //move every particle of every emitter forward by dt seconds and drop the ones that died
+    void update(float dt);
+
+    void draw(Emitter& e, int layer);
+
+    //remove every emitter (called when a script starts)
+    void clear();
+}
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <utility>
 #include "built-in.hpp"
 
+//the longer side of the screen is split into this many broadphase grid cells
+#define BROADPHASE_CELLS 16
+
 //simple 2D physics engine using box collision
 namespace Physics {
     typedef struct {
@@ -42,8 +46,6 @@ namespace Physics {
             void translateX(int amount);
             void translateY(int amount);
 
-            std::vector<Vector2D> get_points();
-
             Vector2D top_right;
             Vector2D top_left;
             Vector2D bottom_right;
@@ -51,11 +53,32 @@ namespace Physics {
             Vector2D center;
     }; //to represent bounding boxes of objects
 
-    Rect2D ObjBoundingBox(BuiltIn::Object& obj); //get the 2D rectangle which is the physics bounding box for an object
+    //separating axis test between the physics boxes of two objects. Boxes that only share an edge or corner count as overlapping
+    bool BoxesOverlap(const BuiltIn::Transform& one, const BuiltIn::Transform& two);
+
+    //fraction (0 to 1) of the move by (dx, dy) done when the moving box, starting from position (x, y), could first touch
+    //the wall box, or infinity if it can't touch it on the way. normal is set to the side of the wall that was hit (unit
+    //length, pointing away from the wall). A box already touching the wall gets 0 (and no normal), unless the move takes it
+    //clear of the wall
+    float TimeOfImpact(const BuiltIn::Transform& moving, float x, float y, float dx, float dy, const BuiltIn::Transform& wall, float& normalX, float& normalY);
+
+    //every pair of objects in objs that are touching (and can collide, see Object::collidesWith), as (index of one, index of the other) with the smaller index first.
+    //pairs is cleared first and comes back sorted. Sorts the boxes along x and sweeps them, so only objects whose boxes
+    //share some of the x axis are actually tested
+    void overlappingPairs(const std::vector<BuiltIn::Object*>& objs, std::vector<std::pair<int, int>>& pairs);
+
+    //physics bodies: objects moved by the engine every frame (see Object::step), in the order they were made bodies
+    void setBody(BuiltIn::Object* obj, bool body);
+    void step(float dt);
 
-    bool PointInRect(point& p, Rect2D& rect); //detect collision
-    bool PointInRect(Vector2D& p, Rect2D& rect);
+    //broadphase: every object is kept in a uniform grid over the screen (by the axis aligned box around its physics box), so
+    //collision queries only have to look at the objects in the same cells instead of every object. Anything off screen is
+    //kept in the cells along the edge it is past
+    void track(BuiltIn::Object* obj);   //new object (called at the end of Object's constructor)
+    void untrack(BuiltIn::Object* obj); //object is going away
+    void moved(BuiltIn::Object* obj);   //x/y/width/height/rotation might have changed, the object's cells are checked before the next query (ignored until tracked)
 
-    bool PointInPollygon(point& one, point& two, point& three, point& p);
-    void RotateRect(Rect2D& rect, float rot); //rotate a Rect2D in place
+    //mark every object in the grid cells covered by the box from (minX, minY) to (maxX, maxY): their nearStamp is set to the
+    //returned value. Objects that aren't marked can't be touching anything inside the box
+    unsigned long long nearby(float minX, float minY, float maxX, float maxY);
 }
\ No newline at end of file
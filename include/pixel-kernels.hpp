@@ -0,0 +1,30 @@
+/*
+    Low level fill routines for the screen buffer.
+
+    Every large write to the screen (clearing, filling a row of a shape, filling a rectangle) goes through these functions.
+    The best implementation for the machine Squiggly is running on (AVX2/SSE2 on x86, NEON on ARM, plain C++ otherwise) is picked
+    once, by whichever fill runs first. That can be from any thread: the pick is done exactly once and is safe to race with
+    other fills.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Kernels {
+    //fill count pixels starting at dst with one value
+    void fill_span(uint32_t* dst, size_t count, uint32_t value);
+    void fill_span(uint16_t* dst, size_t count, uint16_t value);
+
+    //fill a width x height block of pixels. stride is the distance in pixels between the start of each row
+    void fill_rect(uint32_t* dst, size_t stride, size_t width, size_t height, uint32_t value);
+    void fill_rect(uint16_t* dst, size_t stride, size_t width, size_t height, uint16_t value);
+
+    //fill a whole contiguous buffer of count pixels with one value
+    void clear(uint32_t* dst, size_t count, uint32_t value);
+    void clear(uint16_t* dst, size_t count, uint16_t value);
+
+    //name of the implementation picked at startup (for debugging)
+    const char* implementation();
+}
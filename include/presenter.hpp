@@ -0,0 +1,18 @@
+/*
+    Present thread: sends finished frames from the screen to the frontend while the interpreter is already running the
+    next frame, so a slow display transfer (or waiting on the frame limiter) doesn't hold up the script.
+
+    The frontend is initialized, drawn to and cleaned up only from this thread, so it always owns the window/panel.
+*/
+
+#pragma once
+
+namespace Presenter {
+    //initialize the frontend on a new present thread (throws if the frontend fails to start)
+    void start();
+    //drop any frames still waiting, clean up the frontend and join the present thread
+    void stop();
+
+    //rethrow an error hit by the present thread since the last check
+    void checkErrors();
+}
@@ -14,6 +14,9 @@
 #define SCREEN_WIDTH_VAR_NAME "SCREEN_WIDTH"
 #define SCREEN_HEIGHT_VAR_NAME "SCREEN_HEIGHT"
 
+#define SHAPE_CACHE_HITS_VAR_NAME "SHAPE_CACHE_HITS"
+#define SHAPE_CACHE_MISSES_VAR_NAME "SHAPE_CACHE_MISSES"
+
 #define COLLISION_FLAG_VAR_NAME "COL_FLAG"
 #define FLOAT_RETURN_BUCKET_VAR_NAME "F_RET" //bypass the whole "squiggly can't return values from functions" issue. Float values returned from functions can be stored in this bucket variable
 #define INT_RETURN_BUCKET_VAR_NAME "I_RET"
@@ -2,27 +2,245 @@
 
 #include <cstdint>
 #include <vector>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 #include "built-in.hpp"
 #include "frontend.hpp"
+#include "font.hpp"
 
+//resolution frames are drawn at unless another one is picked at startup (see Screen::setResolution)
 #if !BUILD_FOR_RASPI
-#define SCREEN_WIDTH 600
-#define SCREEN_HEIGHT 500
+#define DEFAULT_SCREEN_WIDTH 600
+#define DEFAULT_SCREEN_HEIGHT 500
 #else
-//Dimensions for console
-#define SCREEN_WIDTH 160
-#define SCREEN_HEIGHT 128
+//Dimensions for console (the panel's resolution, this can't be changed on the console)
+#define DEFAULT_SCREEN_WIDTH 160
+#define DEFAULT_SCREEN_HEIGHT 128
 #endif
 
+//biggest resolution (in either direction) that can be picked
+#define MAX_SCREEN_SIZE 4096
+
+//framebuffers start on a boundary this many bytes apart (a cache line, and as wide as any register the pixel kernels use)
+#define FRAME_ALIGNMENT 64
+
+//height of the bands of the screen that are handed out to render workers
+#define RENDER_TILE_ROWS 16
+
+//how many frames can be in flight at once: one being drawn by the interpreter, the rest waiting for (or being sent to) the display
+#define SCREEN_BUFFERS 3
+
+//how many draw commands to make room for up front (the display list only grows past this if a frame needs it)
+#define DISPLAY_LIST_RESERVE 1000
+
+//Framebuffer format. In RGB565 mode the engine draws directly in the ST7735 panel's native format so frames can be sent to the
+//display without converting them first. Otherwise pixels are rgba bytes in that order in memory (what SFML textures expect).
+//Console builds always use 565, pc builds can be switched to it (the SQUIGGLY_RGB565 cmake option) to test the console renderer
+#ifndef SCREEN_FORMAT_RGB565
+#define SCREEN_FORMAT_RGB565 BUILD_FOR_RASPI
+#endif
+
+#if SCREEN_FORMAT_RGB565
+typedef uint16_t pixel_t;
+#else
+typedef uint32_t pixel_t;
+#endif
+
+//rows of a framebuffer, so pixels can be read and written as frame[y][x]
+struct FrameView {
+    pixel_t* pixels;
+    int stride; //pixels from the start of one row to the start of the next
+
+    inline pixel_t* operator[](int y) const { return pixels + (size_t)y*stride; }
+};
+
+//block of rows that changed since the last presented frame (inclusive coordinates)
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} DirtyWindow;
+
+//types of commands that can be put in the display list
+enum DrawCommandType : uint8_t {
+    DRAW_OBJ,  //object shape (rect, triangle, ellipse)
+    DRAW_LINE, //line from (x, y) to (x2, y2)
+    DRAW_TEXT, //x2 glyphs starting at image in the list's glyph buffer, top left corner at (x, y), scaled by y2
+    DRAW_POINTS, //x2 points starting at image in the frame's point buffer, each a y2 x y2 square
+    DRAW_TILES,  //visible part of a tilemap: window number image in the frame's tile windows, top left tile at (x, y)
+};
+
+//one point of a DRAW_POINTS command (particles): top left corner of its square and its color
+typedef struct {
+    int x;
+    int y;
+    pixel_t color;
+} DrawPoint;
+
+//the cells of a tilemap that were on screen when it was drawn (copied, so the map can change afterwards)
+typedef struct {
+    int image;    //tileset asset
+    int tileSize;
+    int columns;
+    int rows;
+    size_t firstCell; //cells are in the frame's tile cell buffer, row by row
+} TileWindow;
+
+//one deferred draw call. Values are copied when the draw is requested, so scripts can keep changing the object afterwards
+typedef struct {
+    DrawCommandType type;
+    uint8_t shape; //BuiltIn::ObjectShape
+    bool fill;
+    int image; //asset index for images, first glyph for text
+    int mask;  //shape cache slot to fill instead of rasterizing (-1 to rasterize)
+    uint8_t r, g, b;
+    int layer; //commands on higher layers are drawn on top
+
+    int x, y;
+    int x2, y2; //width/height for objects, end point for lines
+    float rot;
+    float sine, cosine; //of rot (for objects this comes from their cached transform)
+
+    int minX, minY, maxX, maxY; //bounding box of every pixel the command can touch
+} DrawCommand;
+
 class Screen {
     public:
         Screen();
+        ~Screen();
+
+        //reallocate every buffer for a new resolution. Only called at startup, before anything is drawn or presented
+        void setResolution(int w, int h);
+        int width;
+        int height;
+
+        void clear(); //clear the whole screen to black
+        void clear(uint8_t r, uint8_t g, uint8_t b); //also empties the static layer (filled with this color)
+        void newFrame(); //start a new frame: waits for a free buffer to draw to
+        void present();  //hand the finished frame over to the present thread
 
-        void clear();
+        //present thread side of the handoff
+        bool waitForFrame();    //wait for the next finished frame and point presentBuff at it. Returns false once presenting is stopped
+        void framePresented();  //the frame in presentBuff is on the display, its buffer can be drawn to again
+        void startPresenting();
+        void stopPresenting();  //wakes up both sides, frames that weren't presented yet are dropped
+
+        //display list: draws are only recorded here and rasterized all at once by flush() at the end of the frame.
+        //Static objects go to a separate list that is only rasterized (into staticLayer) when it differs from the last frame's
         void drawObj(BuiltIn::Object& obj);
+        void drawLine(int x1, int y1, int x2, int y2, uint8_t r, uint8_t g, uint8_t b);
+        void drawShape(BuiltIn::ObjectShape shape, int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b); //filled and unrotated, centered on (x, y)
+        void drawText(BuiltIn::Text& text);
+        void drawPoints(const float* xs, const float* ys, const pixel_t* colors, size_t count, int size, int layer);
+        void drawTilemap(BuiltIn::Tilemap& map);
+        void flush(); //erase the frame back to the static layer, then draw this frame's display list on top
+
+        //damage tracking (called by SGraphics whenever it writes to screenBuff). Coordinates are inclusive
+        void markDirty(int x0, int y0, int x1, int y1);
+        inline void markRow(int y, int x0, int x1) { //x0/x1 must already be clipped to the screen. Only touches row y, so workers drawing different rows can mark at the same time
+            drawn->minX[y] = std::min(drawn->minX[y], x0);
+            drawn->maxX[y] = std::max(drawn->maxX[y], x1);
+        }
+
+        //hand every block of consecutive rows that changed between the previous presented frame and presentBuff to a frontend's present code
+        void forEachDirtyWindow(const std::function<void(const DirtyWindow&)>& sink);
+
+        //convert an rgb color to the packed pixel format used by screenBuff
+        static inline pixel_t packColor(uint8_t r, uint8_t g, uint8_t b) {
+            #if SCREEN_FORMAT_RGB565
+            //the panel is wired bgr and expects the high byte of each pixel first
+            uint16_t c = ((b & 0xF8) << 8) | ((g & 0xFC) << 3) | (r >> 3);
+            #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return c;
+            #else
+            return __builtin_bswap16(c);
+            #endif
+            #elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return ((pixel_t)r << 24) | ((pixel_t)g << 16) | ((pixel_t)b << 8) | 0xFFu;
+            #else
+            return (pixel_t)r | ((pixel_t)g << 8) | ((pixel_t)b << 16) | 0xFF000000u;
+            #endif
+        }
+
+        //get the rgb values back out of a packed pixel (565 pixels lose their low bits)
+        static inline void unpackColor(pixel_t p, uint8_t& r, uint8_t& g, uint8_t& b) {
+            const uint8_t* bytes = (const uint8_t*)&p;
+            #if SCREEN_FORMAT_RGB565
+            uint16_t c = (bytes[0] << 8) | bytes[1];
+            b = (c >> 8) & 0xF8;
+            g = (c >> 3) & 0xFC;
+            r = (c << 3) & 0xF8;
+            #else
+            r = bytes[0];
+            g = bytes[1];
+            b = bytes[2];
+            #endif
+        }
+
+        FrameView screenBuff;  //frame being drawn (only touched by the interpreter and render workers)
+        FrameView presentBuff; //frame being presented (only touched by the present thread)
+
+    private:
+        //horizontal extent of the damage on each row (minX > maxX means the row is untouched)
+        typedef struct {
+            std::vector<int> minX;
+            std::vector<int> maxX;
+        } DirtyRows;
+
+        FrameView frame(pixel_t* pixels);
+        void freeBuffers();
+
+        void resetRows(DirtyRows& rows);
+        void markAll(DirtyRows& rows);
+
+        bool queue(DrawCommand& cmd, bool isStatic);
+        void render(std::vector<DrawCommand>& list, const std::vector<Font::Placement>& listGlyphs, bool sortLayers);
+        void rasterize(DrawCommand& cmd, const std::vector<Font::Placement>& listGlyphs);
+        void updateStaticLayer();
+        void restoreFrame();
+
+        std::vector<DrawCommand> commands;       //display list for the current frame
+        std::vector<bool> visible;               //which commands survived culling (reused between frames)
+        std::vector<std::vector<size_t>> tiles;  //indices of the commands touching each tile (band of RENDER_TILE_ROWS rows)
+        bool layered;                            //at least one command this frame is not on layer 0
+        std::vector<Font::Placement> glyphs;     //text drawn this frame (DRAW_TEXT commands point in here)
+        std::vector<DrawPoint> points;           //points drawn this frame (DRAW_POINTS commands point in here, they are never static)
+        std::vector<TileWindow> tileWindows;     //tilemaps drawn this frame (DRAW_TILES commands point in here, also never static)
+        std::vector<uint16_t> tileCells;
+
+        //static layer: everything drawn by static objects, kept in its own buffer and copied under each frame
+        std::vector<DrawCommand> staticCommands; //static display list for the current frame
+        std::vector<DrawCommand> lastStatic;     //static display list staticLayer was rasterized from
+        std::vector<Font::Placement> staticGlyphs;
+        std::vector<Font::Placement> lastStaticGlyphs;
+        bool staticLayered;
+        pixel_t* staticLayer;
+        pixel_t background;                      //color of the static layer where nothing static was drawn
+        DirtyRows staticRows;                    //rows drawn into staticLayer (everything else is background)
+        DirtyRows staticChange;                  //rows that changed the last time staticLayer was redrawn
+        bool staticChanged;                      //staticLayer was redrawn this frame
+        unsigned long long staticVersion;        //bumped every time staticLayer changes
+        unsigned long long bufferVersions[SCREEN_BUFFERS]; //staticVersion each buffer was last erased to
+        int back;                                //index of the buffer being drawn
+
+        pixel_t* buffers[SCREEN_BUFFERS]; //width*height pixels each, aligned to FRAME_ALIGNMENT
+        DirtyRows drawnRows[SCREEN_BUFFERS];   //what was drawn over the static layer the last time each buffer was used (erased when it gets reused)
+        DirtyRows presentRows[SCREEN_BUFFERS]; //what has to be sent to the display when each buffer is presented
+        DirtyRows lastDrawn;                   //drawn rows of the last frame handed to the present thread
+        DirtyRows* drawn;                      //drawn rows of the frame being drawn
 
-        uint8_t screenBuff[SCREEN_HEIGHT][SCREEN_WIDTH][3];
+        //frame n is drawn into buffers[n % SCREEN_BUFFERS]. Counters are only changed while holding frameLock
+        std::mutex frameLock;
+        std::condition_variable frameReady; //present thread waits on this for finished frames
+        std::condition_variable bufferFree; //interpreter waits on this for a buffer to draw to
+        unsigned long long framesSubmitted;
+        unsigned long long framesPresented;
+        int presenting; //buffer index being presented (-1 when none)
+        bool stopped;
 };
 
 extern Screen screen;
\ No newline at end of file
@@ -0,0 +1,40 @@
+/*
+    Cache of rasterized shapes.
+
+    Most scenes draw the same few shapes over and over (enemies, bullets, particles), so instead of rasterizing every object
+    every frame, the spans covered by each (shape, width, height, rotation, fill) combination are recorded once by SGraphics and
+    then just filled in with each object's color. Rotations are rounded to SHAPE_CACHE_ROT_STEPS steps per turn so slowly
+    spinning objects still get reused. The least recently used shapes are thrown out once the cache is full.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "graphics.hpp"
+
+//how many different shapes can be cached at once
+#define SHAPE_CACHE_ENTRIES 256
+
+//most spans all cached shapes can hold together (keeps memory bounded when shapes are large)
+#define SHAPE_CACHE_MAX_SPANS 65536
+
+//rotations are rounded to the nearest 1/SHAPE_CACHE_ROT_STEPS of a turn
+#define SHAPE_CACHE_ROT_STEPS 360
+
+//shapes wider or taller than this are always rasterized directly
+#define SHAPE_CACHE_MAX_SIZE 2048
+
+namespace ShapeCache {
+    //find (or record) the shape a draw command needs. Returns the cache slot to pass to spans(), or -1 if the command
+    //should just be rasterized directly. Slots used during a frame stay valid until the next call to newFrame()
+    int lookup(const DrawCommand& cmd);
+    const std::vector<SGraphics::span>& spans(int slot);
+
+    void newFrame();
+    void clear();
+
+    //lookups since the last clear() that found their shape already cached / had to record it
+    unsigned long long hits();
+    unsigned long long misses();
+}
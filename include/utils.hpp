@@ -13,7 +13,8 @@ namespace Utils
         FLOAT,
         BOOL,
         OBJECT,
-        TEXT
+        TEXT,
+        TILEMAP
     };
 
     typedef struct {
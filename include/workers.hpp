@@ -0,0 +1,25 @@
+/*
+    Small pool of worker threads used to split up per-frame work (currently rasterizing the display list).
+
+    The thread that calls run() always helps with the work, so a pool of size 1 has no extra threads at all and just runs
+    every job in order.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+//the most threads the pool can be asked to start (bigger counts are cut down to this)
+#define MAX_RENDER_THREADS 64
+
+namespace Workers {
+    //start the pool with count threads in total (including the calling thread). 0 picks one thread per cpu core
+    void start(unsigned int count);
+    void stop();
+
+    unsigned int count();
+
+    //call job(0) ... job(jobs-1) spread out over the pool, returns once every job is done
+    void run(size_t jobs, const std::function<void(size_t)>& job);
+}
@@ -3,13 +3,16 @@
 #include <memory>
 #include <string>
 #include <algorithm>
+#include <cmath>
 
 #include "built-in.hpp"
 #include "linter.hpp"
 #include "runner.hpp"
 #include "screen.hpp"
 #include "utils.hpp"
+#include "graphics.hpp"
 #include "physics.hpp"
+#include "assets.hpp"
 
 using namespace BuiltIn;
 
@@ -58,8 +61,41 @@ BuiltIn::Object::Object()
     color_b.type = Utils::VarType::INTEGER;
     color_b.ptr = Utils::createEmptyShared(Utils::VarType::INTEGER);
 
+    //physics body motion (only used once setPhysics(true) is called)
+    vel_x.name = "vel_x";
+    vel_x.type = Utils::VarType::FLOAT;
+    vel_x.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    vel_y.name = "vel_y";
+    vel_y.type = Utils::VarType::FLOAT;
+    vel_y.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    acc_x.name = "acc_x";
+    acc_x.type = Utils::VarType::FLOAT;
+    acc_x.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    acc_y.name = "acc_y";
+    acc_y.type = Utils::VarType::FLOAT;
+    acc_y.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    damping.name = "damping";
+    damping.type = Utils::VarType::FLOAT;
+    damping.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
     shape = ObjectShape::RECT; //default object shape
+    image = -1;
     solid = true;
+    drawLayer = 0;
+    isStatic = false;
+    isBody = false;
+    collisionLayer = 1;         //everything starts on the first layer,
+    collisionMask = UINT32_MAX; //colliding with every layer
+
+    //NaN never compares equal, so the first getTransform() works everything out
+    transform.x = NAN;
+    transform.rotation = NAN;
+
+    tracked = false; //setters leave the broadphase alone until the object is tracked at the end
 
     //get variables from memory (flags set by functions)
     std::string flagName = COLLISION_FLAG_VAR_NAME;
@@ -78,6 +114,14 @@ BuiltIn::Object::Object()
     //default values
     setWidth(OBJ_DEF_WIDTH);
     setHeight(OBJ_DEF_HEIGHT);
+
+    //last, so an object whose constructor throws is never left in the broadphase (the destructor wouldn't untrack it)
+    Physics::track(this);
+}
+
+BuiltIn::Object::~Object()
+{
+    Physics::untrack(this);
 }
 
 float BuiltIn::Object::getX() {
@@ -100,24 +144,40 @@ float BuiltIn::Object::getRotation() {
     return *(float*)rotation.ptr.get();
 }
 
+const BuiltIn::Transform& BuiltIn::Object::getTransform()
+{
+    //values can be written from anywhere (scripts write straight to them through fetchVariable), so the cache is checked
+    //against them instead of relying on every write to invalidate it
+    if(getX() != transform.x || getY() != transform.y || getWidth() != transform.width || getHeight() != transform.height ||
+       getRotation() != transform.rotation)
+        updateTransform();
+
+    return transform;
+}
+
 void BuiltIn::Object::setX(float v) {
     *(float*)x.ptr.get() = v;
+    Physics::moved(this);
 }
 
 void BuiltIn::Object::setY(float v) {
     *(float*)y.ptr.get() = v;
+    Physics::moved(this);
 }
 
 void BuiltIn::Object::setWidth(float v) {
     *(float*)width.ptr.get() = v;
+    Physics::moved(this);
 }
 
 void BuiltIn::Object::setHeight(float v) {
     *(float*)height.ptr.get() = v;
+    Physics::moved(this);
 }
 
 void BuiltIn::Object::setRotation(float v) {
     *(float*)rotation.ptr.get() = v;
+    Physics::moved(this);
 }
 
 void BuiltIn::Object::getColor(uint8_t buffer[3]) {
@@ -144,16 +204,19 @@ void BuiltIn::Object::callFunction(std::string name, std::vector<std::string>& a
         }
     }
     else if(name == "move") {
-        if(args.size() != 2 && args.size() != 3)
-            throwObjectError("'move' expected 2 or 3 arguments, got " + std::to_string(args.size()));
+        if(args.size() < 2 || args.size() > 4)
+            throwObjectError("'move' expected 2 to 4 arguments, got " + std::to_string(args.size()));
 
         float x = *(float*)Utils::convertToVariable(args[0], Utils::VarType::FLOAT).ptr.get();
         float y = *(float*)Utils::convertToVariable(args[1], Utils::VarType::FLOAT).ptr.get();
         bool collide = false;
-        if(args.size() == 3)
+        if(args.size() >= 3)
             collide = *(bool*)Utils::convertToVariable(args[2], Utils::VarType::BOOL).ptr.get();
+        bool slide = false;
+        if(args.size() == 4)
+            slide = *(bool*)Utils::convertToVariable(args[3], Utils::VarType::BOOL).ptr.get();
         
-        move(x, y, collide);
+        move(x, y, collide, slide);
     }
     else if(name == "addWall") {
         //add an object that this object will be a wall for (other object can't pass through)
@@ -207,6 +270,36 @@ void BuiltIn::Object::callFunction(std::string name, std::vector<std::string>& a
         //set internal variable
         solid = *(bool*)Utils::convertToVariable(args[0], Utils::VarType::BOOL).ptr.get();
     }
+    else if(name == "setDrawLayer") {
+        if(args.size() != 1)
+            throwObjectError("'setDrawLayer' expected 1 argument, got " + std::to_string(args.size()));
+
+        drawLayer = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+    }
+    else if(name == "setStatic") {
+        if(args.size() != 1)
+            throwObjectError("'setStatic' expected 1 argument, got " + std::to_string(args.size()));
+
+        isStatic = *(bool*)Utils::convertToVariable(args[0], Utils::VarType::BOOL).ptr.get();
+    }
+    else if(name == "setCollisionLayer") {
+        if(args.size() != 1)
+            throwObjectError("'setCollisionLayer' expected 1 argument, got " + std::to_string(args.size()));
+
+        collisionLayer = (uint32_t)*(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+    }
+    else if(name == "setCollisionMask") {
+        if(args.size() != 1)
+            throwObjectError("'setCollisionMask' expected 1 argument, got " + std::to_string(args.size()));
+
+        collisionMask = (uint32_t)*(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+    }
+    else if(name == "setPhysics") {
+        if(args.size() != 1)
+            throwObjectError("'setPhysics' expected 1 argument, got " + std::to_string(args.size()));
+
+        Physics::setBody(this, *(bool*)Utils::convertToVariable(args[0], Utils::VarType::BOOL).ptr.get());
+    }
     else {
         throwObjectError("Function name \'" + name + "\' does not exist.");
     }
@@ -214,6 +307,10 @@ void BuiltIn::Object::callFunction(std::string name, std::vector<std::string>& a
 
 Utils::SVariable* BuiltIn::Object::fetchVariable(std::string name) 
 {
+    //scripts write to the position and size through the returned variable, so the broadphase has to check this object again
+    if(name=="x" || name=="y" || name=="width" || name=="height" || name=="rotation")
+        Physics::moved(this);
+
     if(name=="x")
         return &x;
     else if(name=="y")
@@ -230,6 +327,16 @@ Utils::SVariable* BuiltIn::Object::fetchVariable(std::string name)
         return &color_g;
     else if(name=="color_b")
         return &color_b;
+    else if(name=="vel_x")
+        return &vel_x;
+    else if(name=="vel_y")
+        return &vel_y;
+    else if(name=="acc_x")
+        return &acc_x;
+    else if(name=="acc_y")
+        return &acc_y;
+    else if(name=="damping")
+        return &damping;
 
     throwObjectError("Object variable \'" + name + "\' not found!");
     return nullptr; //not likely to run at all, but putting it here anyway
@@ -242,23 +349,7 @@ void BuiltIn::Object::draw()
 
 bool BuiltIn::Object::isTouching(Object& other) 
 {
-    //get the bounding boxes for each object
-    Physics::Rect2D one = Physics::ObjBoundingBox(*this);
-    Physics::Rect2D two = Physics::ObjBoundingBox(other);
-
-    //check if any point of either objects is within each other
-    //pretty sure this is super bulky and inefficient, so TODO: make this algorithm the SAT collision algorithm
-    for(Physics::Vector2D& point : one.get_points()) {
-        if(Physics::PointInRect(point, two))
-            return true;
-    }
-
-    for(Physics::Vector2D& point : two.get_points()) {
-        if(Physics::PointInRect(point, one))
-            return true;
-    }
-
-    return false;
+    return collidesWith(other) && Physics::BoxesOverlap(getTransform(), other.getTransform());
 }
 
 void BuiltIn::Object::setObjShape(std::string img) 
@@ -269,6 +360,17 @@ void BuiltIn::Object::setObjShape(std::string img)
         shape = ObjectShape::RECT;
     else if(img == "ELLIPSE")
         shape = ObjectShape::ELLIPSE;
+    else {
+        int id = Assets::find(img);
+        if(id < 0)
+            throwObjectError("Image '@" + img + "' not found! (looked for " + img + ".bmp or " + img + ".ppm next to the script)");
+
+        //images are drawn at their own size, so the object takes on that size for collisions
+        shape = ObjectShape::IMAGE;
+        image = id;
+        setWidth(Assets::get(id).width);
+        setHeight(Assets::get(id).height);
+    }
 }
 
 /**
@@ -277,41 +379,116 @@ void BuiltIn::Object::setObjShape(std::string img)
  * @param x
  * @param y
  * @param collide
+ * @param slide
+ * If the object runs into a wall, the rest of the move is carried on along the wall
  */
-void BuiltIn::Object::move(float x, float y, bool collide)
+void BuiltIn::Object::move(float x, float y, bool collide, bool slide)
 {
     float oldX = getX();
     float oldY = getY();
-
     float newX = oldX+x;
     float newY = oldY+y;
+    Transform from = getTransform();
 
     setX(newX);
     setY(newY);
 
-    if(collide) {
-        //calculate normalized vector of position change for amount to move player
-        Physics::Vector2D diff(newX-oldX, newY-oldY);
-        Physics::Vector2D segmented_movement = diff / OBJ_COL_RESP_SEGMENTS; //divide the area between the new and old positions into discrete sections to check for a resolution to a collision
-        Physics::Vector2D tempDelta;
-        int currSegment = OBJ_COL_RESP_SEGMENTS; //this value will decrease for each position checked
+    if(!collide || walls.empty())
+        return;
+
+    //only walls near the path between the old and new position can be in the way
+    unsigned long long near = Physics::nearby(std::min(oldX, newX) - from.extentX - 1, std::min(oldY, newY) - from.extentY - 1,
+                                              std::max(oldX, newX) + from.extentX + 1, std::max(oldY, newY) + from.extentY + 1);
+
+    //find the first wall the box would touch on its way
+    Object* blocker = nullptr;
+    float hit = INFINITY;
+    float normalX = 0, normalY = 0;
+    for(Object* wall : walls) {
+        if(wall->nearStamp != near || !collidesWith(*wall))
+            continue;
+
+        float nx, ny;
+        float t = Physics::TimeOfImpact(from, oldX, oldY, x, y, wall->getTransform(), nx, ny);
+        if(t < hit) {
+            blocker = wall;
+            hit = t;
+            normalX = nx;
+            normalY = ny;
+        }
+    }
 
-        //check all objects which are walls for collisions
-        for(Object* wall : walls) {
-            while(currSegment > 0 && isTouching(*wall)) {
-                currSegment--;
-                tempDelta = segmented_movement*currSegment; //calculate where the object needs to move from new location
+    //touching counts as colliding, so stop just short of the wall (a hundredth of a pixel, measured straight out from it)
+    float pixel = 1 / std::sqrt(x*x + y*y);
+    float stop = 1;
+    if(blocker) {
+        float approach = std::abs(x*normalX + y*normalY);
+        pixel = approach > 0 ? 1 / approach : hit;
+        stop = std::max(0.0f, hit - pixel / 100);
 
-                newX = oldX + tempDelta.x;
-                newY = oldY + tempDelta.y;
+        setX(oldX + x*stop);
+        setY(oldY + y*stop);
+    }
 
-                setX(newX);
-                setY(newY);
-            }
-        }
+    //rounding can still go the other way when the move crosses 0. Back off a pixel at a time (twice at most) if the box is
+    //touching a wall, and stay put if that isn't enough
+    for(int i=0; i<3 && stop > 0 && touchingWall(near); i++) {
+        stop = i < 2 ? std::max(0.0f, stop - pixel) : 0;
+
+        setX(oldX + x*stop);
+        setY(oldY + y*stop);
+    }
+
+    //carry on along the wall with what's left of the move, minus the part going into the wall
+    if(slide && (normalX != 0 || normalY != 0)) {
+        float restX = x*(1 - stop);
+        float restY = y*(1 - stop);
+        float into = restX*normalX + restY*normalY;
+
+        restX -= into*normalX;
+        restY -= into*normalY;
+        if(restX != 0 || restY != 0)
+            move(restX, restY, true, false);
+    }
+}
+
+void BuiltIn::Object::step(float dt)
+{
+    float& vx = *(float*)vel_x.ptr.get();
+    float& vy = *(float*)vel_y.ptr.get();
+
+    //damping can't do more than stop the object
+    float keep = std::max(0.0f, 1 - *(float*)damping.ptr.get() * dt);
+    vx = (vx + *(float*)acc_x.ptr.get() * dt) * keep;
+    vy = (vy + *(float*)acc_y.ptr.get() * dt) * keep;
+
+    if(vx == 0 && vy == 0)
+        return;
+
+    float oldX = getX();
+    float oldY = getY();
+    float dx = vx*dt;
+    float dy = vy*dt;
+    move(dx, dy, true, true);
+
+    //a wall cut the move short: only the velocity it actually moved with is kept, the part going into the wall is gone
+    if(dt > 0 && (getX() != oldX + dx || getY() != oldY + dy)) {
+        vx = (getX() - oldX) / dt;
+        vy = (getY() - oldY) / dt;
     }
 }
 
+//first wall near the object (marked by Physics::nearby) that it is touching, nullptr if there isn't one
+BuiltIn::Object* BuiltIn::Object::touchingWall(unsigned long long near)
+{
+    for(Object* wall : walls) {
+        if(wall->nearStamp == near && isTouching(*wall))
+            return wall;
+    }
+
+    return nullptr;
+}
+
 /**
  * @brief Make this object a wall for the other object
  * 
@@ -335,6 +512,57 @@ void BuiltIn::Object::addWall(Object* wall, bool add)
     walls.push_back(wall);
 }
 
+/*
+    Work out the cached transform again. Objects mostly just move, so sin/cos are only recalculated when the rotation changed
+*/
+void BuiltIn::Object::updateTransform()
+{
+    Transform& t = transform;
+
+    if(getRotation() != t.rotation) {
+        SGraphics::rotation turn = SGraphics::make_rotation(getRotation());
+        t.sine = turn.sine;
+        t.cosine = turn.cosine;
+    }
+
+    t.x = getX();
+    t.y = getY();
+    t.width = getWidth();
+    t.height = getHeight();
+    t.rotation = getRotation();
+
+    //physics box: centered on the position rounded toward zero, with half the size (also rounded toward zero) either side
+    t.cx = (int)t.x;
+    t.cy = (int)t.y;
+    t.halfW = std::abs((int)(t.width / 2));
+    t.halfH = std::abs((int)(t.height / 2));
+
+    const int signs[4][2] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}}; //top right, top left, bottom left, bottom right
+    for(int i=0; i<4; i++) {
+        float dx = signs[i][0] * t.halfW;
+        float dy = signs[i][1] * t.halfH;
+        t.corners[i][0] = t.cx + dx*t.cosine - dy*t.sine;
+        t.corners[i][1] = t.cy + dx*t.sine + dy*t.cosine;
+    }
+
+    t.extentX = std::abs(t.cosine)*t.halfW + std::abs(t.sine)*t.halfH;
+    t.extentY = std::abs(t.sine)*t.halfW + std::abs(t.cosine)*t.halfH;
+
+    //drawn shapes fit inside the rectangle of the object's size, which when rotated fits inside the circle through its corners.
+    //The circle also covers the slightly different rotation the shape cache draws at
+    int drawW = std::abs((int)t.width)/2 + 1;
+    int drawH = std::abs((int)t.height)/2 + 1;
+    if(t.sine != 0 || t.cosine != 1) {
+        drawW = (int)ceil(sqrt((float)drawW*drawW + (float)drawH*drawH));
+        drawH = drawW;
+    }
+
+    t.minX = t.cx - drawW;
+    t.maxX = t.cx + drawW;
+    t.minY = t.cy - drawH;
+    t.maxY = t.cy + drawH;
+}
+
 /*
     This is just here mainly to make setting the color of the object through c++ code much easier to do
 */
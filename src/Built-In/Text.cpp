@@ -0,0 +1,165 @@
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <algorithm>
+
+#include "built-in.hpp"
+#include "screen.hpp"
+#include "utils.hpp"
+#include "font.hpp"
+
+using namespace BuiltIn;
+
+void throwTextError(std::string message);
+
+BuiltIn::Text::Text()
+{
+    //location (top left corner)
+    x.name = "x";
+    x.type = Utils::VarType::FLOAT;
+    x.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    y.name = "y";
+    y.type = Utils::VarType::FLOAT;
+    y.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    //string that gets drawn
+    text.name = "text";
+    text.type = Utils::VarType::STRING;
+    text.ptr = Utils::createEmptyShared(Utils::VarType::STRING);
+
+    //color
+    color_r.name = "color_r";
+    color_r.type = Utils::VarType::INTEGER;
+    color_r.ptr = Utils::createEmptyShared(Utils::VarType::INTEGER);
+
+    color_g.name = "color_g";
+    color_g.type = Utils::VarType::INTEGER;
+    color_g.ptr = Utils::createEmptyShared(Utils::VarType::INTEGER);
+
+    color_b.name = "color_b";
+    color_b.type = Utils::VarType::INTEGER;
+    color_b.ptr = Utils::createEmptyShared(Utils::VarType::INTEGER);
+
+    scale = TEXT_DEF_SCALE;
+    drawLayer = 0;
+    isStatic = false;
+
+    //nothing laid out yet (empty text has no glyphs)
+    layoutWidth = 0;
+    layoutHeight = 0;
+
+    //default color (white)
+    setColor(255, 255, 255);
+}
+
+float BuiltIn::Text::getX() {
+    return *(float*)x.ptr.get();
+}
+
+float BuiltIn::Text::getY() {
+    return *(float*)y.ptr.get();
+}
+
+void BuiltIn::Text::getColor(uint8_t buffer[3]) {
+    buffer[0] = *(uint8_t*)color_r.ptr.get();
+    buffer[1] = *(uint8_t*)color_g.ptr.get();
+    buffer[2] = *(uint8_t*)color_b.ptr.get();
+}
+
+void BuiltIn::Text::setColor(uint8_t r, uint8_t g, uint8_t b) {
+    *(int*)color_r.ptr.get() = r;
+    *(int*)color_g.ptr.get() = g;
+    *(int*)color_b.ptr.get() = b;
+}
+
+const std::vector<Font::Placement>& BuiltIn::Text::getGlyphs(int& width, int& height)
+{
+    //scripts can change .text directly, so check for a new string here instead of when it is set
+    const std::string& current = *(std::string*)text.ptr.get();
+    if(current != laidOut) {
+        laidOut = current;
+        Font::layout(laidOut, glyphs, layoutWidth, layoutHeight);
+    }
+
+    width = layoutWidth;
+    height = layoutHeight;
+    return glyphs;
+}
+
+void BuiltIn::Text::callFunction(std::string name, std::vector<std::string>& args)
+{
+    if(name == "draw") {
+        draw();
+    }
+    else if(name == "setText") {
+        if(args.size() != 1)
+            throwTextError("'setText' expected 1 argument, got " + std::to_string(args.size()));
+
+        *(std::string*)text.ptr.get() = *(std::string*)Utils::convertToVariable(args[0], Utils::VarType::STRING).ptr.get();
+    }
+    else if(name == "setColor") {
+        if(args.size() != 3)
+            throwTextError("'setColor' expected 3 arguments, got "+ std::to_string(args.size()));
+
+        int r = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+        int g = *(int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get();
+        int b = *(int*)Utils::convertToVariable(args[2], Utils::VarType::INTEGER).ptr.get();
+
+        setColor(std::clamp(r, 0, 255), std::clamp(g, 0, 255), std::clamp(b, 0, 255));
+    }
+    else if(name == "setScale") {
+        if(args.size() != 1)
+            throwTextError("'setScale' expected 1 argument, got " + std::to_string(args.size()));
+
+        int s = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+        if(s < 1 || s > MAX_TEXT_SCALE)
+            throwTextError("'setScale' -> scale has to be between 1 and " + std::to_string(MAX_TEXT_SCALE) + ", got " + std::to_string(s));
+
+        scale = s;
+    }
+    else if(name == "setDrawLayer") {
+        if(args.size() != 1)
+            throwTextError("'setDrawLayer' expected 1 argument, got " + std::to_string(args.size()));
+
+        drawLayer = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+    }
+    else if(name == "setStatic") {
+        if(args.size() != 1)
+            throwTextError("'setStatic' expected 1 argument, got " + std::to_string(args.size()));
+
+        isStatic = *(bool*)Utils::convertToVariable(args[0], Utils::VarType::BOOL).ptr.get();
+    }
+    else {
+        throwTextError("Function name \'" + name + "\' does not exist.");
+    }
+}
+
+Utils::SVariable* BuiltIn::Text::fetchVariable(std::string name)
+{
+    if(name=="x")
+        return &x;
+    else if(name=="y")
+        return &y;
+    else if(name=="text")
+        return &text;
+    else if(name=="color_r")
+        return &color_r;
+    else if(name=="color_g")
+        return &color_g;
+    else if(name=="color_b")
+        return &color_b;
+
+    throwTextError("Text variable \'" + name + "\' not found!");
+    return nullptr;
+}
+
+void BuiltIn::Text::draw()
+{
+    screen.drawText(*this);
+}
+
+void throwTextError(std::string message) {
+    throw std::runtime_error("Built in text error : " + message);
+}
@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#include "built-in.hpp"
+#include "linter.hpp"
+#include "runner.hpp"
+#include "screen.hpp"
+#include "utils.hpp"
+#include "assets.hpp"
+
+using namespace BuiltIn;
+
+void throwTilemapError(std::string message);
+
+BuiltIn::Tilemap::Tilemap()
+{
+    //world coordinate at the top left corner of the screen
+    scroll_x.name = "scroll_x";
+    scroll_x.type = Utils::VarType::FLOAT;
+    scroll_x.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    scroll_y.name = "scroll_y";
+    scroll_y.type = Utils::VarType::FLOAT;
+    scroll_y.ptr = Utils::createEmptyShared(Utils::VarType::FLOAT);
+
+    //empty until setSize is called
+    columns = 0;
+    rows = 0;
+    tileSize = TILEMAP_DEF_TILE_SIZE;
+    tileset = -1;
+    drawLayer = 0;
+
+    //getTile returns its value in $I_RET
+    std::string retName = INT_RETURN_BUCKET_VAR_NAME;
+    retName.insert(0, 1, BUILT_IN_VAR_PREFIX);
+    Utils::SVariable* tmp = Runner::fetchVariable(retName);
+    if(tmp)
+        intReturn = (int*)tmp->ptr.get();
+    else
+        throwTilemapError("Unable to fetch int return variable!"); //only seen by Squiggly devs
+}
+
+float BuiltIn::Tilemap::getScrollX() {
+    return *(float*)scroll_x.ptr.get();
+}
+
+float BuiltIn::Tilemap::getScrollY() {
+    return *(float*)scroll_y.ptr.get();
+}
+
+int BuiltIn::Tilemap::tileAt(float x, float y)
+{
+    float column = floorf(x / tileSize);
+    float row = floorf(y / tileSize);
+
+    //written so NaN coordinates also count as outside
+    if(!(column >= 0 && row >= 0 && column < columns && row < rows))
+        return 0;
+
+    return cells[(size_t)row*columns + (size_t)column];
+}
+
+void BuiltIn::Tilemap::callFunction(std::string name, std::vector<std::string>& args)
+{
+    if(name == "draw") {
+        draw();
+    }
+    else if(name == "setSize") {
+        if(args.size() != 2)
+            throwTilemapError("'setSize' expected 2 arguments, got " + std::to_string(args.size()));
+
+        int c = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+        int r = *(int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get();
+        if(c < 1 || r < 1 || (long long)c*r > MAX_TILEMAP_CELLS)
+            throwTilemapError("'setSize' -> maps have to be at least 1x1 and at most " + std::to_string(MAX_TILEMAP_CELLS) + " cells, got " + std::to_string(c) + "x" + std::to_string(r));
+
+        //every cell starts out empty
+        columns = c;
+        rows = r;
+        cells.assign((size_t)c*r, 0);
+    }
+    else if(name == "setTileset") {
+        if(args.size() != 2)
+            throwTilemapError("'setTileset' expected 2 arguments, got " + std::to_string(args.size()));
+        if(args[0][0] != IMAGE_DECLARATION_PREFIX)
+            throwTilemapError("Argument passed to 'setTileset' (" + args[0] + ") is not an image declaration! (Should start with @)");
+
+        std::string img = args[0].substr(1, args[0].length() - 1);
+        int id = Assets::find(img);
+        if(id < 0)
+            throwTilemapError("Image '@" + img + "' not found! (looked for " + img + ".bmp or " + img + ".ppm next to the script)");
+
+        int size = *(int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get();
+        if(size < 1 || size > MAX_TILE_SIZE)
+            throwTilemapError("'setTileset' -> tile size has to be between 1 and " + std::to_string(MAX_TILE_SIZE) + ", got " + std::to_string(size));
+        if(Assets::get(id).width < size || Assets::get(id).height < size)
+            throwTilemapError("'setTileset' -> '@" + img + "' is smaller than one " + std::to_string(size) + "x" + std::to_string(size) + " tile");
+
+        tileset = id;
+        tileSize = size;
+    }
+    else if(name == "setTile") {
+        if(args.size() != 3)
+            throwTilemapError("'setTile' expected 3 arguments, got " + std::to_string(args.size()));
+
+        int c = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+        int r = *(int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get();
+        int tile = *(int*)Utils::convertToVariable(args[2], Utils::VarType::INTEGER).ptr.get();
+
+        setTiles(c, r, 1, 1, tile);
+    }
+    else if(name == "fill") {
+        if(args.size() != 5)
+            throwTilemapError("'fill' expected 5 arguments, got " + std::to_string(args.size()));
+
+        int c = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+        int r = *(int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get();
+        int w = *(int*)Utils::convertToVariable(args[2], Utils::VarType::INTEGER).ptr.get();
+        int h = *(int*)Utils::convertToVariable(args[3], Utils::VarType::INTEGER).ptr.get();
+        int tile = *(int*)Utils::convertToVariable(args[4], Utils::VarType::INTEGER).ptr.get();
+
+        setTiles(c, r, w, h, tile);
+    }
+    else if(name == "getTile") {
+        if(args.size() != 2)
+            throwTilemapError("'getTile' expected 2 arguments, got " + std::to_string(args.size()));
+
+        float x = *(float*)Utils::convertToVariable(args[0], Utils::VarType::FLOAT).ptr.get();
+        float y = *(float*)Utils::convertToVariable(args[1], Utils::VarType::FLOAT).ptr.get();
+
+        *intReturn = tileAt(x, y);
+    }
+    else if(name == "setDrawLayer") {
+        if(args.size() != 1)
+            throwTilemapError("'setDrawLayer' expected 1 argument, got " + std::to_string(args.size()));
+
+        drawLayer = *(int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get();
+    }
+    else {
+        throwTilemapError("Function name \'" + name + "\' does not exist.");
+    }
+}
+
+Utils::SVariable* BuiltIn::Tilemap::fetchVariable(std::string name)
+{
+    if(name=="scroll_x")
+        return &scroll_x;
+    else if(name=="scroll_y")
+        return &scroll_y;
+
+    throwTilemapError("Tilemap variable \'" + name + "\' not found!");
+    return nullptr;
+}
+
+void BuiltIn::Tilemap::draw()
+{
+    if(tileset < 0)
+        throwTilemapError("'draw' -> no tileset to draw with (call setTileset first)");
+
+    screen.drawTilemap(*this);
+}
+
+/*
+    Set a block of cells to one tile. The block is clipped to the map, so filling past the edges is fine
+*/
+void BuiltIn::Tilemap::setTiles(int column, int row, int width, int height, int tile)
+{
+    if(tile < 0 || tile > UINT16_MAX)
+        throwTilemapError("Tile " + std::to_string(tile) + " is out of range (tiles are 0 to " + std::to_string(UINT16_MAX) + ")");
+
+    int c0 = std::max(column, 0);
+    int r0 = std::max(row, 0);
+    int c1 = (int)std::min((long long)column + width, (long long)columns);
+    int r1 = (int)std::min((long long)row + height, (long long)rows);
+
+    for(int r=r0; r<r1; r++)
+        std::fill(cells.begin() + (size_t)r*columns + c0, cells.begin() + (size_t)r*columns + std::max(c0, c1), (uint16_t)tile);
+}
+
+void throwTilemapError(std::string message) {
+    throw std::runtime_error("Built in tilemap error : " + message);
+}
@@ -3,12 +3,17 @@
 #include <climits>
 #include <cstdlib>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
 
 #include "built-in.hpp"
 #include "utils.hpp"
 #include "runner.hpp"
 #include "linter.hpp"
 #include "graphics.hpp"
+#include "screen.hpp"
+#include "particles.hpp"
+#include "physics.hpp"
 
 using namespace BuiltIn;
 
@@ -16,7 +21,28 @@ using namespace BuiltIn;
 int* INT_RET_PTR = nullptr;
 float* FLOAT_RET_PTR = nullptr;
 
+//biggest position or size (either way) a batched draw passes on to the screen. Anything bigger is far off screen anyway, and
+//this leaves room for adding half a size to a position without overflowing an int
+#define BATCH_COORD_LIMIT (INT_MAX/4)
+
+//argument of a batched draw (DRAW_RECTS etc): an array with one value per shape, or a single value used for every shape
+typedef struct {
+    std::vector<Utils::SVariable>* values; //nullptr for a single value
+    float value;
+} BatchArg;
+
+//objects and touching pairs of the last ^COLLISION_ call, kept so checking every frame doesn't allocate
+std::vector<BuiltIn::Object*> pairObjects;
+std::vector<std::pair<int, int>> pairsFound;
+
 inline void throwError(std::string message);
+Particles::Emitter* fetchEmitter(const std::string& function, std::string& arg);
+size_t fetchBatchArgs(const std::string& function, std::vector<std::string>& args, size_t geometry, BatchArg* out);
+std::vector<Utils::SVariable>& fetchArray(const std::string& function, std::string& arg, Utils::VarType type);
+void findPairs(const std::string& function, std::string& arg);
+inline float batchValue(const BatchArg& arg, size_t i);
+inline uint8_t batchColor(const BatchArg& arg, size_t i);
+inline bool batchCoord(const BatchArg& arg, size_t i, int& out);
 
 void BuiltIn::fetchBuiltInReturnVariables() {
     //fetch int return variable
@@ -107,7 +133,219 @@ void BuiltIn::runFunction(std::string name, std::vector<std::string>& args)
             color.b = 255;
         }
 
-        SGraphics::draw_line(p1, p2, color);
+        screen.drawLine(p1.x, p1.y, p2.x, p2.y, color.r, color.g, color.b);
+    }
+    else if(name == "DRAW_RECTS") {
+        //x, y, width, height, r, g, b
+        BatchArg batch[7];
+        size_t count = fetchBatchArgs(name, args, 4, batch);
+
+        int x, y, w, h;
+        for(size_t i=0; i<count; i++) {
+            if(!batchCoord(batch[0], i, x) || !batchCoord(batch[1], i, y) || !batchCoord(batch[2], i, w) || !batchCoord(batch[3], i, h))
+                continue;
+
+            screen.drawShape(BuiltIn::ObjectShape::RECT, x, y, w, h, batchColor(batch[4], i), batchColor(batch[5], i), batchColor(batch[6], i));
+        }
+    }
+    else if(name == "DRAW_CIRCLES") {
+        //x, y, radius, r, g, b
+        BatchArg batch[6];
+        size_t count = fetchBatchArgs(name, args, 3, batch);
+
+        int x, y, radius;
+        for(size_t i=0; i<count; i++) {
+            if(!batchCoord(batch[0], i, x) || !batchCoord(batch[1], i, y) || !batchCoord(batch[2], i, radius))
+                continue;
+
+            int diameter = std::min(radius, BATCH_COORD_LIMIT/2) * 2;
+            screen.drawShape(BuiltIn::ObjectShape::ELLIPSE, x, y, diameter, diameter, batchColor(batch[3], i), batchColor(batch[4], i), batchColor(batch[5], i));
+        }
+    }
+    else if(name == "DRAW_LINES") {
+        //x1, y1, x2, y2, r, g, b
+        BatchArg batch[7];
+        size_t count = fetchBatchArgs(name, args, 4, batch);
+
+        int x1, y1, x2, y2;
+        for(size_t i=0; i<count; i++) {
+            if(!batchCoord(batch[0], i, x1) || !batchCoord(batch[1], i, y1) || !batchCoord(batch[2], i, x2) || !batchCoord(batch[3], i, y2))
+                continue;
+
+            screen.drawLine(x1, y1, x2, y2, batchColor(batch[4], i), batchColor(batch[5], i), batchColor(batch[6], i));
+        }
+    }
+    else if(name == "TOUCHING") {
+        if(args.size() != 2 && args.size() != 3)
+            throwError("TOUCHING: expected 2 or 3 arguments, got " + std::to_string(args.size()));
+
+        Utils::SVariable* objVar = Runner::fetchVariable(args[0]);
+        if(!objVar || objVar->type != Utils::VarType::OBJECT)
+            throwError("TOUCHING: '" + args[0] + "' is not an Object variable");
+        BuiltIn::Object& obj = *(BuiltIn::Object*)objVar->ptr.get();
+
+        std::vector<Utils::SVariable>& others = fetchArray(name, args[1], Utils::VarType::OBJECT);
+        std::vector<Utils::SVariable>* hits = args.size() == 3 ? &fetchArray(name, args[2], Utils::VarType::BOOL) : nullptr;
+
+        //only objects sharing a broadphase cell with obj get the full test
+        const BuiltIn::Transform& t = obj.getTransform();
+        unsigned long long near = Physics::nearby(t.cx - t.extentX, t.cy - t.extentY, t.cx + t.extentX, t.cy + t.extentY);
+
+        int count = 0;
+        for(size_t i=0; i<others.size(); i++) {
+            BuiltIn::Object* other = (BuiltIn::Object*)others[i].ptr.get();
+            bool hit = other != &obj && other->nearStamp == near && obj.collidesWith(*other) && Physics::BoxesOverlap(t, other->getTransform());
+            count += hit;
+
+            if(hits && i < hits->size())
+                *(bool*)(*hits)[i].ptr.get() = hit;
+        }
+
+        *INT_RET_PTR = count;
+    }
+    else if(name == "COLLISION_PAIRS") {
+        if(args.size() != 3)
+            throwError("COLLISION_PAIRS: expected 3 arguments, got " + std::to_string(args.size()));
+
+        findPairs(name, args[0]);
+        std::vector<Utils::SVariable>& firsts = fetchArray(name, args[1], Utils::VarType::INTEGER);
+        std::vector<Utils::SVariable>& seconds = fetchArray(name, args[2], Utils::VarType::INTEGER);
+
+        //pairs that don't fit in the arrays are dropped
+        size_t count = std::min(pairsFound.size(), std::min(firsts.size(), seconds.size()));
+        for(size_t i=0; i<count; i++) {
+            *(int*)firsts[i].ptr.get() = pairsFound[i].first;
+            *(int*)seconds[i].ptr.get() = pairsFound[i].second;
+        }
+
+        *INT_RET_PTR = count;
+    }
+    else if(name == "COLLISION_COUNTS") {
+        if(args.size() != 2)
+            throwError("COLLISION_COUNTS: expected 2 arguments, got " + std::to_string(args.size()));
+
+        findPairs(name, args[0]);
+        std::vector<Utils::SVariable>& counts = fetchArray(name, args[1], Utils::VarType::INTEGER);
+
+        for(Utils::SVariable& c : counts)
+            *(int*)c.ptr.get() = 0;
+        for(std::pair<int, int>& p : pairsFound) {
+            if((size_t)p.first < counts.size())
+                (*(int*)counts[p.first].ptr.get())++;
+            if((size_t)p.second < counts.size())
+                (*(int*)counts[p.second].ptr.get())++;
+        }
+
+        *INT_RET_PTR = pairsFound.size();
+    }
+    else if(name == "PARTICLES_NEW") {
+        if(args.size() != 1)
+            throwError("PARTICLES_NEW: expected 1 argument, got " + std::to_string(args.size()));
+
+        int capacity = *((int*)Utils::convertToVariable(args[0], Utils::VarType::INTEGER).ptr.get());
+        if(capacity < 1 || capacity > MAX_PARTICLES)
+            throwError("PARTICLES_NEW: capacity has to be between 1 and " + std::to_string(MAX_PARTICLES) + ", got " + std::to_string(capacity));
+
+        //emitter id goes in I_RET, every other PARTICLES_ function takes it as the first argument
+        *INT_RET_PTR = Particles::create(capacity);
+    }
+    else if(name == "PARTICLES_EMIT") {
+        if(args.size() != 4)
+            throwError("PARTICLES_EMIT: expected 4 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        int count = *((int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get());
+        float x = *((float*)Utils::convertToVariable(args[2], Utils::VarType::FLOAT).ptr.get());
+        float y = *((float*)Utils::convertToVariable(args[3], Utils::VarType::FLOAT).ptr.get());
+
+        Particles::emit(*e, count, x, y);
+    }
+    else if(name == "PARTICLES_SPEED") {
+        if(args.size() != 3 && args.size() != 5)
+            throwError("PARTICLES_SPEED: expected either 3 or 5 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        e->speedMin = *((float*)Utils::convertToVariable(args[1], Utils::VarType::FLOAT).ptr.get());
+        e->speedMax = *((float*)Utils::convertToVariable(args[2], Utils::VarType::FLOAT).ptr.get());
+
+        if(args.size() == 5) {
+            e->angle = *((float*)Utils::convertToVariable(args[3], Utils::VarType::FLOAT).ptr.get());
+            e->spread = *((float*)Utils::convertToVariable(args[4], Utils::VarType::FLOAT).ptr.get());
+        }
+    }
+    else if(name == "PARTICLES_LIFE") {
+        if(args.size() != 3)
+            throwError("PARTICLES_LIFE: expected 3 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        float min = *((float*)Utils::convertToVariable(args[1], Utils::VarType::FLOAT).ptr.get());
+        float max = *((float*)Utils::convertToVariable(args[2], Utils::VarType::FLOAT).ptr.get());
+
+        if(!(min >= 0 && max >= min))
+            throwError("PARTICLES_LIFE: lifetimes have to be positive with min <= max");
+
+        e->lifeMin = min;
+        e->lifeMax = max;
+    }
+    else if(name == "PARTICLES_GRAVITY") {
+        if(args.size() != 3)
+            throwError("PARTICLES_GRAVITY: expected 3 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        e->gravityX = *((float*)Utils::convertToVariable(args[1], Utils::VarType::FLOAT).ptr.get());
+        e->gravityY = *((float*)Utils::convertToVariable(args[2], Utils::VarType::FLOAT).ptr.get());
+    }
+    else if(name == "PARTICLES_COLOR") {
+        if(args.size() != 4)
+            throwError("PARTICLES_COLOR: expected 4 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        int r = *((int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get());
+        int g = *((int*)Utils::convertToVariable(args[2], Utils::VarType::INTEGER).ptr.get());
+        int b = *((int*)Utils::convertToVariable(args[3], Utils::VarType::INTEGER).ptr.get());
+
+        //only particles emitted after this get the new color
+        e->emitColor = Screen::packColor(std::clamp(r, 0, 255), std::clamp(g, 0, 255), std::clamp(b, 0, 255));
+    }
+    else if(name == "PARTICLES_SIZE") {
+        if(args.size() != 2)
+            throwError("PARTICLES_SIZE: expected 2 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        int size = *((int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get());
+        if(size < 1 || size > MAX_PARTICLE_SIZE)
+            throwError("PARTICLES_SIZE: size has to be between 1 and " + std::to_string(MAX_PARTICLE_SIZE) + ", got " + std::to_string(size));
+
+        e->size = size;
+    }
+    else if(name == "PARTICLES_DRAW") {
+        if(args.size() != 1 && args.size() != 2)
+            throwError("PARTICLES_DRAW: expected either 1 or 2 arguments, got " + std::to_string(args.size()));
+
+        Particles::Emitter* e = fetchEmitter(name, args[0]);
+        int layer = 0;
+        if(args.size() == 2)
+            layer = *((int*)Utils::convertToVariable(args[1], Utils::VarType::INTEGER).ptr.get());
+
+        Particles::draw(*e, layer);
+    }
+    else if(name == "PARTICLES_COUNT") {
+        if(args.size() != 1)
+            throwError("PARTICLES_COUNT: expected 1 argument, got " + std::to_string(args.size()));
+
+        *INT_RET_PTR = fetchEmitter(name, args[0])->count;
+    }
+    else if(name == "PARTICLES_CLEAR") {
+        if(args.size() != 1)
+            throwError("PARTICLES_CLEAR: expected 1 argument, got " + std::to_string(args.size()));
+
+        fetchEmitter(name, args[0])->count = 0;
+    }
+    else if(name == "PARTICLES_FREE") {
+        if(args.size() != 1)
+            throwError("PARTICLES_FREE: expected 1 argument, got " + std::to_string(args.size()));
+
+        Particles::destroy(*fetchEmitter(name, args[0]));
     }
     else {
         //throw error
@@ -147,6 +385,113 @@ void BuiltIn::GenRandNum() {
     *FLOAT_RET_PTR = (double)rand()/RAND_MAX;
 }
 
+//emitter whose id is passed as the first argument of a PARTICLES_ function
+Particles::Emitter* fetchEmitter(const std::string& function, std::string& arg)
+{
+    int id = *((int*)Utils::convertToVariable(arg, Utils::VarType::INTEGER).ptr.get());
+
+    Particles::Emitter* e = Particles::get(id);
+    if(!e)
+        throwError(function + ": no particle emitter with id " + std::to_string(id) + " (make one with PARTICLES_NEW first)");
+
+    return e;
+}
+
+//array variable passed to a built in function, which has to hold values of the given type
+std::vector<Utils::SVariable>& fetchArray(const std::string& function, std::string& arg, Utils::VarType type)
+{
+    Utils::SVariable* var = Runner::fetchVariable(arg, true);
+    if(!var || !var->isArray || var->type != type)
+        throwError(function + ": '" + arg + "' is not an array of " + Utils::varTypeToString(type) + " values");
+
+    return *(std::vector<Utils::SVariable>*)var->ptr.get();
+}
+
+//every touching pair of objects in the OBJECT array passed to a ^COLLISION_ function, left in pairsFound
+void findPairs(const std::string& function, std::string& arg)
+{
+    std::vector<Utils::SVariable>& objs = fetchArray(function, arg, Utils::VarType::OBJECT);
+
+    pairObjects.clear();
+    for(Utils::SVariable& o : objs)
+        pairObjects.push_back((BuiltIn::Object*)o.ptr.get());
+
+    Physics::overlappingPairs(pairObjects, pairsFound);
+}
+
+/*
+    Sort out the arguments of a batched draw: geometry values, optionally followed by r, g, b (white if left out). Any argument
+    can be an int or float array (one value per shape) or a single value shared by every shape, but at least one has to be an
+    array. out needs room for geometry + 3 arguments. Returns how many shapes to draw (the length of the shortest array)
+*/
+size_t fetchBatchArgs(const std::string& function, std::vector<std::string>& args, size_t geometry, BatchArg* out)
+{
+    if(args.size() != geometry && args.size() != geometry + 3)
+        throwError(function + ": expected either " + std::to_string(geometry) + " or " + std::to_string(geometry + 3) + " arguments, got " + std::to_string(args.size()));
+
+    size_t count = SIZE_MAX;
+    for(size_t i=0; i<geometry + 3; i++) {
+        out[i].values = nullptr;
+        out[i].value = 255;
+        if(i >= args.size())
+            continue;
+
+        //only plain names can be arrays, anything else is an expression
+        bool name = !args[i].empty() && std::isalpha(args[i][0]);
+        for(char c : args[i])
+            name &= std::isalnum(c) || c == '_';
+
+        Utils::SVariable* var = name ? Runner::fetchVariable(args[i], true) : nullptr;
+        if(!var || !var->isArray) {
+            out[i].value = *((float*)Utils::convertToVariable(args[i], Utils::VarType::FLOAT).ptr.get());
+            continue;
+        }
+
+        if(var->type != Utils::VarType::INTEGER && var->type != Utils::VarType::FLOAT)
+            throwError(function + ": array '" + args[i] + "' has to be an int or float array, not " + Utils::varTypeToString(var->type));
+
+        out[i].values = (std::vector<Utils::SVariable>*)var->ptr.get();
+        count = std::min(count, out[i].values->size());
+    }
+
+    if(count == SIZE_MAX)
+        throwError(function + ": at least one argument has to be an array (use DRAW_LINE or an OBJECT to draw a single shape)");
+
+    return count;
+}
+
+//value of a batch argument for shape i
+inline float batchValue(const BatchArg& arg, size_t i)
+{
+    if(!arg.values)
+        return arg.value;
+
+    const Utils::SVariable& v = (*arg.values)[i];
+    if(v.type == Utils::VarType::INTEGER)
+        return *(int*)v.ptr.get();
+
+    return *(float*)v.ptr.get();
+}
+
+//batch argument for shape i as a color channel (clamped to avoid over/underflow)
+inline uint8_t batchColor(const BatchArg& arg, size_t i)
+{
+    float c = batchValue(arg, i);
+    return c > 0 ? std::min(c, 255.0f) : 0; //NaN counts as 0
+}
+
+//batch argument for shape i as a position or size, clamped so the screen's bounding box math can't overflow.
+//Returns false (skip the shape) for NaN and infinity, which don't convert to an int at all
+inline bool batchCoord(const BatchArg& arg, size_t i, int& out)
+{
+    float v = batchValue(arg, i);
+    if(!std::isfinite(v))
+        return false;
+
+    out = (int)std::clamp(v, -(float)BATCH_COORD_LIMIT, (float)BATCH_COORD_LIMIT);
+    return true;
+}
+
 inline void throwError(std::string message) {
     throw std::runtime_error("Built in function failed! : " + message);
 }
\ No newline at end of file
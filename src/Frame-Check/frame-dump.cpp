@@ -0,0 +1,141 @@
+/*
+    Headless frontend for checking the console's RGB565 renderer on pc (see the frame_check target in CMakeLists.txt).
+
+    Runs a script at the console's resolution for a few frames and writes the last presented frame to a file as it ends up in
+    the ST7735 panel's memory: 128 pixels wide and 160 tall (the panel is mounted sideways), two bytes per pixel, high byte
+    first. Each build gets there the way its console present code does:
+     - an rgba build redoes the console's present loop from before the framebuffer was 565: every pixel goes through
+       Color565 on the unpacked color and is put at IMDrawPixel(y, width-x-1) in the library's image buffer
+     - a 565 build sends its framebuffer as is with the panel set to 270 degrees, so each pixel is placed where the panel's
+       270 degree mapping puts it
+    The two files are byte for byte the same when the 565 renderer and the rotated transfer show exactly what the panel used
+    to get.
+
+    Usage: frame_dump <script> <output file>
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <atomic>
+#include <thread>
+
+#include "frontend.hpp"
+#include "main.hpp"
+
+//how many frames the script runs for before it is told to exit
+#define FRAME_DUMP_FRAMES 3
+
+bool writeFrame();
+void panelPixel(int x, int y, uint16_t color);
+uint16_t Color565(int16_t r, int16_t g, int16_t b);
+
+const char* outputPath = nullptr;
+int framesRun = 0;
+std::atomic<int> framesDumped(0);
+std::atomic<bool> dumpFailed(false);
+std::vector<uint8_t> panelBytes;
+
+float Frontend::getHorAxis() { return 0; }
+float Frontend::getVertAxis() { return 0; }
+bool Frontend::getABtn() { return false; }
+bool Frontend::getBBtn() { return false; }
+
+//frames still waiting to be presented are dropped when the program stops, so wait for each one to be written first
+bool Frontend::getExitBtn() {
+    framesRun++;
+    while(framesDumped < framesRun)
+        std::this_thread::yield();
+
+    return framesRun >= FRAME_DUMP_FRAMES;
+}
+
+void Frontend::init() {
+    panelBytes.resize((size_t)screen.width * screen.height * 2);
+}
+
+void Frontend::cleanUp() {}
+
+void Frontend::drawScreen() {
+    #if SCREEN_FORMAT_RGB565
+    //frame rows are sent in order with the panel at 270 degrees: the panel swaps rows and columns and runs its rows the other
+    //way, so row y of the frame fills panel column y and column x of the frame lands on panel row width-x-1
+    for(int y=0; y<screen.height; y++) {
+        const uint8_t* bytes = (const uint8_t*)screen.presentBuff[y];
+        for(int x=0; x<screen.width; x++, bytes += 2) {
+            int panelX = y;
+            int panelY = screen.width - x - 1;
+            panelPixel(panelX, panelY, (bytes[0] << 8) | bytes[1]); //already in the panel's byte order
+        }
+    }
+    #else
+    //the console's old present loop
+    uint16_t color;
+    uint8_t r, g, b;
+    for(int x=0; x<screen.width; x++) {
+        for(int y=0; y<screen.height; y++) {
+            Screen::unpackColor(screen.presentBuff[y][x], r, g, b);
+            color = Color565((int16_t)b, (int16_t)g, (int16_t)r);
+            panelPixel(y, screen.width-x-1, color); //IMDrawPixel
+        }
+    }
+    #endif
+
+    if(!writeFrame())
+        dumpFailed = true;
+    framesDumped++;
+}
+
+/*
+    Overwrite the output file with the frame that was just presented, so it ends up holding the last one
+*/
+bool writeFrame() {
+    FILE* file = fopen(outputPath, "wb");
+    if(!file) {
+        std::cerr << "Unable to open \'" << outputPath << "\' for writing!" << std::endl;
+        return false;
+    }
+
+    size_t written = fwrite(panelBytes.data(), 1, panelBytes.size(), file);
+    fclose(file);
+    return written == panelBytes.size();
+}
+
+/*
+    Put one pixel in the panel's memory (screen.height pixels wide, screen.width tall), high byte first
+*/
+void panelPixel(int x, int y, uint16_t color) {
+    uint8_t* dst = &panelBytes[((size_t)y*screen.height + x) * 2];
+    dst[0] = color >> 8;
+    dst[1] = color & 0xFF;
+}
+
+//same conversion as ST7735_TFT::Color565
+uint16_t Color565(int16_t r, int16_t g, int16_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        std::cout << "Usage: frame_dump <script> <output file>" << std::endl;
+        return 1;
+    }
+    outputPath = argv[2];
+
+    //draw at the panel's resolution, like the console does
+    char resOption[] = "--res";
+    char resValue[] = "160x128";
+    char* args[] = { argv[0], argv[1], resOption, resValue };
+
+    std::vector<std::string> fileLines;
+    if(parse_args(4, args, fileLines))
+        return 1;
+
+    remove(outputPath); //a frame that never gets presented has to fail the check, not leave an old file behind
+
+    Workers::start(renderThreads);
+    run_squiggly(fileLines);
+    Workers::stop();
+
+    return dumpFailed || framesDumped < FRAME_DUMP_FRAMES ? 1 : 0;
+}
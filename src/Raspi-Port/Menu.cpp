@@ -101,10 +101,10 @@ void draw_menu(ST7735_TFT* screen, std::vector<std::string>& paths, size_t selec
         filename = paths[i].substr(path_len, paths[i].length()-path_len);
 
         //calculate if we are still rendering on screen (avoid overflow/underflow when calculating text position)
-        uint8_t text_y = (SCREEN_HEIGHT/2)+((uint8_t)i*TEXT_PIXEL_HEIGHT) - (uint8_t)menu_offset - TEXT_PIXEL_HEIGHT;
+        uint8_t text_y = (DEFAULT_SCREEN_HEIGHT/2)+((uint8_t)i*TEXT_PIXEL_HEIGHT) - (uint8_t)menu_offset - TEXT_PIXEL_HEIGHT;
 
         //make sure we're drawing on the screen (prevent underflow/overflow)
-        if(text_y < 0 || text_y>=SCREEN_HEIGHT-TEXT_PIXEL_HEIGHT)
+        if(text_y < 0 || text_y>=DEFAULT_SCREEN_HEIGHT-TEXT_PIXEL_HEIGHT)
             continue;
 
         screen->TFTdrawText(TEXT_LEFT_BUFFER, text_y, 
@@ -116,7 +116,7 @@ void draw_menu(ST7735_TFT* screen, std::vector<std::string>& paths, size_t selec
 
     //draw line under selected path
     uint8_t line_length = paths[selection].substr(path_len, paths[selection].length()-path_len).length() * 6;
-    screen->TFTdrawFastHLine(TEXT_LEFT_BUFFER, (uint8_t)((SCREEN_HEIGHT/2)-(TEXT_PIXEL_HEIGHT/2)), line_length, 0xFFFF, true);
+    screen->TFTdrawFastHLine(TEXT_LEFT_BUFFER, (uint8_t)((DEFAULT_SCREEN_HEIGHT/2)-(TEXT_PIXEL_HEIGHT/2)), line_length, 0xFFFF, true);
 
     screen->IMDisplay(); //render the in memory buffer to the physical screen
 }
@@ -0,0 +1,341 @@
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+
+#include "assets.hpp"
+#include "linter.hpp"
+
+using namespace Assets;
+
+//decoded image before it gets converted: rgba bytes, alpha is 0 for transparent pixels
+typedef struct {
+    int width;
+    int height;
+    std::vector<uint8_t> rgba;
+} RawImage;
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data);
+void decodeBMP(const std::vector<uint8_t>& data, RawImage& out, const std::string& path);
+void decodePPM(const std::vector<uint8_t>& data, RawImage& out, const std::string& path);
+void addImage(const std::string& name, RawImage& raw);
+void throwAssetError(std::string message);
+
+//everything shared by all loaded images
+std::vector<Image> images;
+std::vector<pixel_t> atlas;
+std::vector<Run> runs;
+std::vector<uint32_t> rowStarts;
+
+//names that setShape already handles without loading anything
+const char* builtInShapes[] = { "RECT", "TRIANGLE", "ELLIPSE" };
+
+/**
+ * @brief Load every image referenced in a script
+ *
+ * @param lines script source (before it gets tokenized)
+ * @param directory folder the script is in (empty or ending in a slash)
+ */
+void Assets::load(const std::vector<std::string>& lines, const std::string& directory)
+{
+    clear();
+
+    for(const std::string& line : lines) {
+        size_t at = 0;
+        while((at = line.find(IMAGE_DECLARATION_PREFIX, at)) != std::string::npos) {
+            size_t end = ++at;
+            while(end < line.length() && (isalnum(line[end]) || line[end] == '_'))
+                end++;
+
+            std::string name = line.substr(at, end - at);
+            at = end;
+
+            if(name.empty() || find(name) >= 0 || std::find(std::begin(builtInShapes), std::end(builtInShapes), name) != std::end(builtInShapes))
+                continue;
+
+            //names are usually all caps in scripts, files don't have to be
+            std::string lower = name;
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
+
+            std::vector<uint8_t> data;
+            RawImage raw;
+            bool found = false;
+            for(const std::string& file : { name, lower }) {
+                std::string path = directory + file;
+                if(readFile(path + ".bmp", data)) {
+                    decodeBMP(data, raw, path + ".bmp");
+                    found = true;
+                    break;
+                }
+                if(readFile(path + ".ppm", data)) {
+                    decodePPM(data, raw, path + ".ppm");
+                    found = true;
+                    break;
+                }
+            }
+
+            //no file with this name, setShape will complain if the script actually uses it
+            if(found)
+                addImage(name, raw);
+        }
+    }
+}
+
+void Assets::clear()
+{
+    images.clear();
+    atlas.clear();
+    runs.clear();
+    rowStarts.clear();
+}
+
+int Assets::find(const std::string& name)
+{
+    for(size_t i=0; i<images.size(); i++) {
+        if(images[i].name == name)
+            return i;
+    }
+
+    return -1;
+}
+
+const Image& Assets::get(int image)
+{
+    return images[image];
+}
+
+const pixel_t* Assets::rowPixels(const Image& img, int y)
+{
+    return &atlas[img.pixels + (size_t)y*img.width];
+}
+
+const Run* Assets::rowRuns(const Image& img, int y, size_t& count)
+{
+    uint32_t first = rowStarts[img.rows + y];
+    count = rowStarts[img.rows + y + 1] - first;
+    return runs.data() + first;
+}
+
+/*
+    Convert a decoded image to screen pixels and split its rows up into opaque runs
+*/
+void addImage(const std::string& name, RawImage& raw)
+{
+    Image img;
+    img.name = name;
+    img.width = raw.width;
+    img.height = raw.height;
+    img.pixels = atlas.size();
+    img.rows = rowStarts.size();
+
+    atlas.resize(atlas.size() + (size_t)raw.width*raw.height);
+    pixel_t* dst = &atlas[img.pixels];
+
+    for(int y=0; y<raw.height; y++) {
+        rowStarts.push_back(runs.size());
+
+        Run run = { 0, 0 };
+        bool open = false;
+        for(int x=0; x<raw.width; x++) {
+            const uint8_t* p = &raw.rgba[((size_t)y*raw.width + x) * 4];
+            bool opaque = p[3] != 0 && !(p[0] == 255 && p[1] == 0 && p[2] == 255);
+
+            *dst++ = Screen::packColor(p[0], p[1], p[2]);
+
+            if(opaque && !open) {
+                run.x = x;
+                run.length = 0;
+                open = true;
+            }
+            if(opaque)
+                run.length++;
+            if(!opaque && open) {
+                runs.push_back(run);
+                open = false;
+            }
+        }
+
+        if(open)
+            runs.push_back(run);
+    }
+    rowStarts.push_back(runs.size()); //end of the last row
+
+    images.push_back(img);
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open())
+        return false;
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+//little endian helpers for reading bmp headers
+uint32_t readU32(const std::vector<uint8_t>& d, size_t i) {
+    return d[i] | (d[i+1] << 8) | (d[i+2] << 16) | ((uint32_t)d[i+3] << 24);
+}
+
+uint16_t readU16(const std::vector<uint8_t>& d, size_t i) {
+    return d[i] | (d[i+1] << 8);
+}
+
+//pull one channel out of a pixel using a bitfield mask, scaled to 0-255
+uint8_t maskChannel(uint32_t pixel, uint32_t mask) {
+    if(mask == 0)
+        return 255;
+
+    int shift = 0;
+    while(!(mask & (1u << shift)))
+        shift++;
+
+    uint32_t max = mask >> shift;
+    return (uint8_t)(((pixel & mask) >> shift) * 255 / max);
+}
+
+/*
+    Uncompressed 24 or 32 bit bmp files (what most image editors save by default)
+*/
+void decodeBMP(const std::vector<uint8_t>& data, RawImage& out, const std::string& path)
+{
+    if(data.size() < 54 || data[0] != 'B' || data[1] != 'M')
+        throwAssetError("'" + path + "' is not a bmp file!");
+
+    uint32_t dataOffset = readU32(data, 10);
+    uint32_t headerSize = readU32(data, 14);
+    int32_t width = (int32_t)readU32(data, 18);
+    int32_t height = (int32_t)readU32(data, 22);
+    uint16_t bpp = readU16(data, 28);
+    uint32_t compression = readU32(data, 30);
+
+    //rows are stored bottom up unless the height is negative
+    bool bottomUp = height > 0;
+    height = std::abs(height);
+
+    if(width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+        throwAssetError("'" + path + "' has an unsupported size (images can be at most " + std::to_string(MAX_IMAGE_SIZE) + " pixels across)");
+    if((bpp != 24 && bpp != 32) || (compression != 0 && compression != 3) || (compression == 3 && bpp != 32))
+        throwAssetError("'" + path + "' is not an uncompressed 24 or 32 bit bmp!");
+
+    //32 bit bitfield images keep their masks right after the 40 byte header (inside it for newer header versions)
+    uint32_t masks[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0 };
+    if(compression == 3) {
+        if(data.size() < 70)
+            throwAssetError("'" + path + "' is cut off!");
+
+        for(int i=0; i<3; i++)
+            masks[i] = readU32(data, 54 + i*4);
+        if(headerSize >= 56)
+            masks[3] = readU32(data, 66);
+    }
+
+    size_t stride = ((size_t)width * (bpp / 8) + 3) & ~(size_t)3;
+    if(dataOffset + stride * height > data.size())
+        throwAssetError("'" + path + "' is cut off!");
+
+    out.width = width;
+    out.height = height;
+    out.rgba.resize((size_t)width * height * 4);
+
+    for(int y=0; y<height; y++) {
+        const uint8_t* src = &data[dataOffset + stride * (bottomUp ? height - 1 - y : y)];
+        uint8_t* dst = &out.rgba[(size_t)y * width * 4];
+
+        for(int x=0; x<width; x++) {
+            if(bpp == 24) {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = 255;
+                src += 3;
+            } else {
+                uint32_t p = src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+                dst[0] = maskChannel(p, masks[0]);
+                dst[1] = maskChannel(p, masks[1]);
+                dst[2] = maskChannel(p, masks[2]);
+                dst[3] = maskChannel(p, masks[3]) < 128 ? 0 : 255; //only fully on or off, no blending
+                src += 4;
+            }
+            dst += 4;
+        }
+    }
+}
+
+//next number in a ppm header (skipping whitespace and comments)
+int readPPMValue(const std::vector<uint8_t>& data, size_t& i, const std::string& path)
+{
+    while(i < data.size()) {
+        if(data[i] == '#') {
+            while(i < data.size() && data[i] != '\n')
+                i++;
+        }
+        else if(isspace(data[i]))
+            i++;
+        else
+            break;
+    }
+
+    if(i >= data.size() || !isdigit(data[i]))
+        throwAssetError("'" + path + "' is not a valid ppm file!");
+
+    int value = 0;
+    while(i < data.size() && isdigit(data[i]) && value <= 65535)
+        value = value*10 + (data[i++] - '0');
+
+    return value;
+}
+
+/*
+    Binary (P6) or plain text (P3) ppm files
+*/
+void decodePPM(const std::vector<uint8_t>& data, RawImage& out, const std::string& path)
+{
+    if(data.size() < 2 || data[0] != 'P' || (data[1] != '6' && data[1] != '3'))
+        throwAssetError("'" + path + "' is not a P3 or P6 ppm file!");
+
+    bool binary = data[1] == '6';
+    size_t i = 2;
+    int width = readPPMValue(data, i, path);
+    int height = readPPMValue(data, i, path);
+    int maxValue = readPPMValue(data, i, path);
+
+    if(width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+        throwAssetError("'" + path + "' has an unsupported size (images can be at most " + std::to_string(MAX_IMAGE_SIZE) + " pixels across)");
+    if(maxValue <= 0 || maxValue > 65535)
+        throwAssetError("'" + path + "' has an invalid max color value!");
+
+    size_t samples = (size_t)width * height * 3;
+    size_t sampleBytes = maxValue > 255 ? 2 : 1;
+    if(binary) {
+        i++; //exactly one whitespace character between the header and the pixels
+        if(i + samples * sampleBytes > data.size())
+            throwAssetError("'" + path + "' is cut off!");
+    }
+
+    out.width = width;
+    out.height = height;
+    out.rgba.resize((size_t)width * height * 4);
+
+    for(size_t s=0; s<samples; s++) {
+        int value;
+        if(!binary)
+            value = readPPMValue(data, i, path);
+        else if(sampleBytes == 2) {
+            value = (data[i] << 8) | data[i+1];
+            i += 2;
+        }
+        else
+            value = data[i++];
+
+        out.rgba[(s/3)*4 + s%3] = (uint8_t)(std::min(value, maxValue) * 255 / maxValue);
+        if(s % 3 == 2)
+            out.rgba[(s/3)*4 + 3] = 255;
+    }
+}
+
+void throwAssetError(std::string message) {
+    throw std::runtime_error("Unable to load image! : " + message);
+}
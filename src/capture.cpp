@@ -0,0 +1,418 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+#include "capture.hpp"
+
+//frame copied by the present thread, waiting to be written
+typedef struct {
+    int buffer;
+    unsigned long long number;
+} QueuedFrame;
+
+void throwCaptureError(std::string message);
+void writerLoop();
+void encodePNG(const pixel_t* pixels, int width, int height, std::vector<uint8_t>& raw, std::vector<uint8_t>& out);
+void deflateFixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size);
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value);
+uint32_t chunkCrc(const uint8_t* data, size_t size, uint32_t crc=0);
+uint32_t adlerChecksum(const uint8_t* data, size_t size);
+
+std::thread writerThread;
+std::mutex captureLock;
+std::condition_variable framesWaiting;
+std::atomic<bool> capturing(false); //checked by the present thread before taking the lock
+bool writerStopping = false;
+
+std::string outputFolder;
+int captureWidth = 0;
+int captureHeight = 0;
+std::vector<pixel_t> captureBuffers[CAPTURE_BUFFERS]; //captureWidth*captureHeight pixels each
+std::vector<int> idleBuffers;
+std::deque<QueuedFrame> queuedFrames;
+
+//only changed while holding captureLock
+unsigned long long framesSeen = 0;
+unsigned long long framesDropped = 0;
+unsigned long long framesWritten = 0;
+unsigned long long writeErrors = 0;
+
+void Capture::start(const std::string& folder)
+{
+    stop();
+
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+    if(error)
+        throwCaptureError("Unable to make capture folder '" + folder + "' (" + error.message() + ")");
+
+    outputFolder = folder;
+    captureWidth = screen.width;
+    captureHeight = screen.height;
+
+    //every buffer is allocated up front, capturing a frame never allocates
+    idleBuffers.clear();
+    for(int i=0; i<CAPTURE_BUFFERS; i++) {
+        captureBuffers[i].assign((size_t)captureWidth*captureHeight, 0);
+        idleBuffers.push_back(i);
+    }
+
+    queuedFrames.clear();
+    framesSeen = 0;
+    framesDropped = 0;
+    framesWritten = 0;
+    writeErrors = 0;
+    writerStopping = false;
+
+    writerThread = std::thread(writerLoop);
+    capturing = true;
+}
+
+void Capture::stop()
+{
+    if(!writerThread.joinable())
+        return;
+
+    capturing = false;
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        writerStopping = true;
+    }
+    framesWaiting.notify_one();
+    writerThread.join();
+
+    std::cout << "Captured " << framesWritten << " frames to '" << outputFolder << "' (" << framesDropped << " dropped";
+    if(writeErrors > 0)
+        std::cout << ", " << writeErrors << " could not be written";
+    std::cout << ")" << std::endl;
+
+    //give the memory back, captures can be large
+    for(std::vector<pixel_t>& buffer : captureBuffers)
+        std::vector<pixel_t>().swap(buffer);
+}
+
+void Capture::frame(const FrameView& view)
+{
+    if(!capturing)
+        return;
+
+    QueuedFrame f;
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        f.number = framesSeen++;
+
+        if(idleBuffers.empty()) {
+            //writer is behind, skip this frame rather than hold up the present thread
+            framesDropped++;
+            return;
+        }
+
+        f.buffer = idleBuffers.back();
+        idleBuffers.pop_back();
+    }
+
+    //the buffer belongs to this thread until it is queued, so the copy happens outside of the lock
+    pixel_t* dst = captureBuffers[f.buffer].data();
+    for(int y=0; y<captureHeight; y++)
+        memcpy(dst + (size_t)y*captureWidth, view[y], captureWidth * sizeof(pixel_t));
+
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        queuedFrames.push_back(f);
+    }
+    framesWaiting.notify_one();
+}
+
+/*
+    Writer thread: encode queued frames and write them out, oldest first. Frames still queued when capturing stops are
+    written before the thread exits
+*/
+void writerLoop()
+{
+    std::vector<uint8_t> raw; //reused for every frame
+    std::vector<uint8_t> png;
+
+    while(true) {
+        QueuedFrame f;
+        {
+            std::unique_lock<std::mutex> lock(captureLock);
+            framesWaiting.wait(lock, [] { return !queuedFrames.empty() || writerStopping; });
+            if(queuedFrames.empty())
+                return;
+
+            f = queuedFrames.front();
+            queuedFrames.pop_front();
+        }
+
+        encodePNG(captureBuffers[f.buffer].data(), captureWidth, captureHeight, raw, png);
+
+        //the pixels aren't needed anymore once they are encoded
+        {
+            std::lock_guard<std::mutex> lock(captureLock);
+            idleBuffers.push_back(f.buffer);
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "frame_%06llu.png", f.number);
+        std::string path = (std::filesystem::path(outputFolder) / name).string();
+
+        FILE* file = fopen(path.c_str(), "wb");
+        bool written = file && fwrite(png.data(), 1, png.size(), file) == png.size();
+        if(file)
+            written &= fclose(file) == 0;
+
+        std::lock_guard<std::mutex> lock(captureLock);
+        if(written)
+            framesWritten++;
+        else
+            writeErrors++;
+    }
+}
+
+/*
+    PNG encoding. Frames are stored as 8 bit rgb, unfiltered, compressed with a single fixed Huffman deflate block. That
+    is far from the smallest file possible, but game frames are mostly long runs of the same color, which this handles
+    well, and it is fast enough to keep up with the frame rate without needing zlib
+*/
+void encodePNG(const pixel_t* pixels, int width, int height, std::vector<uint8_t>& raw, std::vector<uint8_t>& out)
+{
+    //scanlines: filter type (0, none) followed by the row's rgb bytes
+    size_t rowBytes = 1 + (size_t)width*3;
+    raw.resize(rowBytes * height);
+    for(int y=0; y<height; y++) {
+        uint8_t* row = &raw[y*rowBytes];
+        const pixel_t* src = pixels + (size_t)y*width;
+        row[0] = 0;
+
+        for(int x=0; x<width; x++)
+            Screen::unpackColor(src[x], row[1 + x*3], row[2 + x*3], row[3 + x*3]);
+    }
+
+    out.clear();
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    //width, height, 8 bits per channel, rgb, deflate, no filtering beyond per row, not interlaced
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    const uint8_t format[5] = {8, 2, 0, 0, 0};
+    header.insert(header.end(), format, format + 5);
+    appendChunk(out, "IHDR", header.data(), header.size());
+
+    //zlib stream: header (deflate, 32k window, fastest), the compressed scanlines and a checksum of them
+    std::vector<uint8_t> data = {0x78, 0x01};
+    data.reserve(raw.size() / 4);
+    deflateFixed(raw.data(), raw.size(), data);
+    appendBigEndian(data, adlerChecksum(raw.data(), raw.size()));
+    appendChunk(out, "IDAT", data.data(), data.size());
+
+    appendChunk(out, "IEND", nullptr, 0);
+}
+
+//writes deflate's bit stream (least significant bit first)
+typedef struct {
+    std::vector<uint8_t>* out;
+    uint64_t bits;
+    int count;
+} BitWriter;
+
+inline void putBits(BitWriter& w, uint32_t value, int length)
+{
+    w.bits |= (uint64_t)value << w.count;
+    w.count += length;
+    while(w.count >= 8) {
+        w.out->push_back(w.bits & 0xFF);
+        w.bits >>= 8;
+        w.count -= 8;
+    }
+}
+
+//fixed Huffman codes (RFC 1951 3.2.6). They are sent most significant bit first, so they are stored reversed
+typedef struct {
+    uint16_t symbol[288]; //literal/length symbols
+    uint8_t symbolLength[288];
+    uint8_t distance[30]; //all 5 bits long
+} FixedCodes;
+
+uint32_t reverseBits(uint32_t value, int length)
+{
+    uint32_t r = 0;
+    for(int i=0; i<length; i++) {
+        r = (r << 1) | (value & 1);
+        value >>= 1;
+    }
+    return r;
+}
+
+const FixedCodes& fixedCodes()
+{
+    static const FixedCodes codes = [] {
+        FixedCodes c;
+        for(int s=0; s<288; s++) {
+            if(s < 144)      { c.symbol[s] = reverseBits(0x30 + s, 8);        c.symbolLength[s] = 8; }
+            else if(s < 256) { c.symbol[s] = reverseBits(0x190 + s - 144, 9); c.symbolLength[s] = 9; }
+            else if(s < 280) { c.symbol[s] = reverseBits(s - 256, 7);         c.symbolLength[s] = 7; }
+            else             { c.symbol[s] = reverseBits(0xC0 + s - 280, 8);  c.symbolLength[s] = 8; }
+        }
+        for(int d=0; d<30; d++)
+            c.distance[d] = reverseBits(d, 5);
+        return c;
+    }();
+
+    return codes;
+}
+
+inline void putSymbol(BitWriter& w, const FixedCodes& codes, int symbol)
+{
+    putBits(w, codes.symbol[symbol], codes.symbolLength[symbol]);
+}
+
+void putMatch(BitWriter& w, const FixedCodes& codes, int length, int distance)
+{
+    static const int lengthBase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+    static const int lengthExtra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+    static const int distBase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,
+                                     8193,12289,16385,24577};
+    static const int distExtra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+    int l = std::upper_bound(lengthBase, lengthBase + 29, length) - lengthBase - 1;
+    putSymbol(w, codes, 257 + l);
+    putBits(w, length - lengthBase[l], lengthExtra[l]);
+
+    int d = std::upper_bound(distBase, distBase + 30, distance) - distBase - 1;
+    putBits(w, codes.distance[d], 5);
+    putBits(w, distance - distBase[d], distExtra[d]);
+}
+
+/*
+    Compress data as one final fixed Huffman block. Matches are found through a table of the last position each 3 byte
+    sequence was seen at (no chains, the first match found is taken and extended as far as it goes)
+*/
+void deflateFixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    const int hashBits = 15;
+    const size_t window = 32768;
+    const size_t maxMatch = 258;
+    std::vector<int64_t> last(1 << hashBits, -1);
+
+    const FixedCodes& codes = fixedCodes();
+    BitWriter w = {&out, 0, 0};
+    putBits(w, 1, 1); //final block
+    putBits(w, 1, 2); //fixed Huffman codes
+
+    auto hash = [&](size_t i) {
+        uint32_t v = data[i] | (data[i+1] << 8) | (data[i+2] << 16);
+        return (v * 2654435761u) >> (32 - hashBits);
+    };
+
+    size_t i = 0;
+    while(i < size) {
+        size_t length = 0;
+        size_t distance = 0;
+
+        if(i + 3 <= size) {
+            uint32_t h = hash(i);
+            int64_t candidate = last[h];
+            last[h] = i;
+
+            if(candidate >= 0 && i - candidate <= window) {
+                size_t limit = std::min(maxMatch, size - i);
+                while(length < limit && data[candidate + length] == data[i + length])
+                    length++;
+                distance = i - candidate;
+            }
+        }
+
+        if(length < 3) {
+            putSymbol(w, codes, data[i]);
+            i++;
+            continue;
+        }
+
+        putMatch(w, codes, length, distance);
+
+        //remember the positions inside the match too, so the next rows can match against them
+        for(size_t j=i+1; j<i+length && j+3<=size; j++)
+            last[hash(j)] = j;
+        i += length;
+    }
+
+    putSymbol(w, codes, 256); //end of block
+    if(w.count > 0)
+        putBits(w, 0, 8 - w.count);
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    appendBigEndian(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if(size > 0)
+        out.insert(out.end(), data, data + size);
+
+    //checksum covers the type and the data
+    appendBigEndian(out, chunkCrc(&out[start], size + 4));
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+uint32_t chunkCrc(const uint8_t* data, size_t size, uint32_t crc)
+{
+    static uint32_t table[256];
+    static std::once_flag tableMade;
+    std::call_once(tableMade, [] {
+        for(uint32_t n=0; n<256; n++) {
+            uint32_t c = n;
+            for(int k=0; k<8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    });
+
+    crc = ~crc;
+    for(size_t i=0; i<size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t adlerChecksum(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while(size > 0) {
+        //largest block that can't overflow b before taking the modulo
+        size_t block = std::min(size, (size_t)5552);
+        for(size_t i=0; i<block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+
+        data += block;
+        size -= block;
+    }
+
+    return (b << 16) | a;
+}
+
+void throwCaptureError(std::string message) {
+    throw std::runtime_error("Capture error : " + message);
+}
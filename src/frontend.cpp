@@ -1,4 +1,8 @@
 #include <string>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 
 #include "frontend.hpp"
 #include "screen.hpp"
@@ -20,34 +24,57 @@ void throwFrontendError(std::string message);
     bool ESC_pressed = false;
 
     //code taken from Display_Lib_RPI GitHub: https://github.com/gavinlyonsrepo/Display_Lib_RPI/blob/main/examples/st7735/Hello_world_SWSPI/main.cpp
-    ST7735_TFT myTFT(SCREEN_HEIGHT, SCREEN_WIDTH);
+    ST7735_TFT myTFT(DEFAULT_SCREEN_HEIGHT, DEFAULT_SCREEN_WIDTH);
 
     uint8_t SetupSPI(void); // setup + user options for software SPI
 
+    #if SCREEN_FORMAT_RGB565
+    void sendWindow(const DirtyWindow& window);
+    std::vector<pixel_t> windowStaging; //rows of a window narrower than the screen get packed together here before sending
+    #endif
+
     void Frontend::init() {
         if(SetupSPI()!=0)
             throwFrontendError("Unable to initialize SPI screen!");
 
         myTFT.TFTfillScreen(ST7735_BLACK);
         myTFT.IMClear();
+
+        #if SCREEN_FORMAT_RGB565
+        windowStaging.resize((size_t)screen.width * screen.height);
+
+        //let the panel rotate the image instead of transposing every frame (270 degrees matches the pixel mapping of the old conversion loop)
+        myTFT.TFTsetRotation(myTFT.TFT_rotate_e::TFT_Degrees_270);
+        #endif
     }
 
     void Frontend::cleanUp() {
+        #if SCREEN_FORMAT_RGB565
+        myTFT.TFTsetRotation(myTFT.TFT_rotate_e::TFT_Degrees_0);
+        #endif
+
         myTFT.TFTfillScreen(ST7735_BLACK);
         myTFT.TFTPowerDown();
         bcm2835_close();
     }
 
     void Frontend::drawScreen() {
+        #if SCREEN_FORMAT_RGB565
+        //screen buffer is already 565 in the panel's byte order, only send the rows that changed since the last frame
+        screen.forEachDirtyWindow(sendWindow);
+        #else
         uint16_t color;
-        for(int x=0; x<SCREEN_WIDTH; x++) {
-            for(int y=0; y<SCREEN_HEIGHT; y++) {
-                color = myTFT.Color565(((int16_t)screen.screenBuff[y][x][2]), ((int16_t)screen.screenBuff[y][x][1]), ((int16_t)screen.screenBuff[y][x][0]));
-                myTFT.IMDrawPixel(y, SCREEN_WIDTH-x-1, color);
+        uint8_t r, g, b;
+        for(int x=0; x<screen.width; x++) {
+            for(int y=0; y<screen.height; y++) {
+                Screen::unpackColor(screen.presentBuff[y][x], r, g, b);
+                color = myTFT.Color565((int16_t)b, (int16_t)g, (int16_t)r);
+                myTFT.IMDrawPixel(y, screen.width-x-1, color);
             }
         }
 
         myTFT.IMDisplay();
+        #endif
     }
 
     void Frontend::updateReadings() {
@@ -97,6 +124,25 @@ void throwFrontendError(std::string message);
         }
     }
 
+    #if SCREEN_FORMAT_RGB565
+    /*
+        Send one changed block of the screen buffer to the panel in a single transfer
+    */
+    void sendWindow(const DirtyWindow& window) {
+        int w = window.x1 - window.x0 + 1;
+        int h = window.y1 - window.y0 + 1;
+
+        pixel_t* data = &screen.presentBuff[window.y0][0];
+        if(w != screen.presentBuff.stride) {
+            for(int y=0; y<h; y++)
+                memcpy(&windowStaging[y*w], &screen.presentBuff[window.y0+y][window.x0], w*sizeof(pixel_t));
+            data = windowStaging.data();
+        }
+
+        myTFT.TFTdrawBitmap16Data(window.x0, window.y0, (uint8_t*)data, w, h);
+    }
+    #endif
+
     ST7735_TFT* Frontend::get_tft() {
         return &myTFT;
     }
@@ -135,8 +181,8 @@ void throwFrontendError(std::string message);
 
         uint8_t OFFSET_COL = 0;  // 2, These offsets can be adjusted for any issues->
         uint8_t OFFSET_ROW = 0; // 3, with manufacture tolerance/defects at edge of display
-        uint16_t TFT_WIDTH = SCREEN_HEIGHT;// Screen width in pixels (128)
-        uint16_t TFT_HEIGHT = SCREEN_WIDTH; // Screen height in pixels (160)
+        uint16_t TFT_WIDTH = DEFAULT_SCREEN_HEIGHT;// Screen width in pixels (128)
+        uint16_t TFT_HEIGHT = DEFAULT_SCREEN_WIDTH; // Screen height in pixels (160)
 
         uint16_t SWSPI_CommDelay = 0; //uS GPIO SW SPI delay
 
@@ -161,8 +207,6 @@ void throwFrontendError(std::string message);
 #else
     //PC port using opencv
     #include <SFML/Graphics/RenderWindow.hpp>
-    #include <SFML/Graphics/Image.hpp>
-    #include <SFML/Graphics/Color.hpp>
     #include <SFML/Graphics/Texture.hpp>
     #include <SFML/Graphics/Sprite.hpp>
     
@@ -172,11 +216,38 @@ void throwFrontendError(std::string message);
     sf::Texture texture;
     sf::Sprite sprite(texture);
 
+    //the window lives on the present thread, the interpreter only ever checks this to know if it was closed
+    std::atomic<bool> windowClosed(false);
+
     void handleSFMLEvents();
 
+    #if SCREEN_FORMAT_RGB565
+    //only used when testing the console's 565 framebuffer on pc: frames are expanded back to rgba before uploading
+    std::vector<uint8_t> rgbaStaging;
+    #endif
+
     void Frontend::init() {
-        window.create(sf::VideoMode({SCREEN_WIDTH, SCREEN_HEIGHT}), "Squiggly Project");
+        //frames smaller than the default resolution are blown up by the biggest whole number that keeps the window within it,
+        //so every pixel of the frame is the same size on screen
+        unsigned int scale = std::max(1, std::min(DEFAULT_SCREEN_WIDTH / screen.width, DEFAULT_SCREEN_HEIGHT / screen.height));
+        unsigned int w = screen.width;
+        unsigned int h = screen.height;
+
+        window.create(sf::VideoMode({w * scale, h * scale}), "Squiggly Project");
         window.setFramerateLimit(60);
+
+        //screen texture is created once and overwritten with the contents of the screen buffer every frame
+        if(!texture.resize({w, h}))
+            throwFrontendError("Unable to create screen texture!");
+        texture.setSmooth(false); //nearest neighbor scaling keeps pixels sharp
+
+        sprite.setTexture(texture, true);
+        sprite.setScale({(float)scale, (float)scale});
+        windowClosed = false;
+
+        #if SCREEN_FORMAT_RGB565
+        rgbaStaging.resize((size_t)w * h * 4);
+        #endif
     }
 
     void Frontend::cleanUp() {
@@ -186,22 +257,26 @@ void throwFrontendError(std::string message);
     void Frontend::drawScreen() {
         handleSFMLEvents();
 
-        //create uint8_t version of in-memory buffer
-        sf::Image img({SCREEN_WIDTH, SCREEN_HEIGHT}, sf::Color::Black);
-
-        for(unsigned int x=0; x<SCREEN_WIDTH; x++) {
-            for(unsigned int y=0; y<SCREEN_HEIGHT; y++) {
-                img.setPixel({x, y}, sf::Color(screen.screenBuff[y][x][0], screen.screenBuff[y][x][1], screen.screenBuff[y][x][2], 255));
+        #if SCREEN_FORMAT_RGB565
+        uint8_t* dst = rgbaStaging.data();
+        for(int y=0; y<screen.height; y++) {
+            for(int x=0; x<screen.width; x++) {
+                Screen::unpackColor(screen.presentBuff[y][x], dst[0], dst[1], dst[2]);
+                dst[3] = 255;
+                dst += 4;
             }
         }
+        texture.update(rgbaStaging.data());
+        #else
+        //screen buffer is already stored as rgba rows, upload the changed rows straight to the texture
+        screen.forEachDirtyWindow([](const DirtyWindow& window) {
+            texture.update((const uint8_t*)&screen.presentBuff[window.y0][0], 
+                           {(unsigned int)screen.width, (unsigned int)(window.y1 - window.y0 + 1)}, 
+                           {0, (unsigned int)window.y0});
+        });
+        #endif
 
         window.clear();
-
-        bool t = texture.loadFromImage(img);
-        if(!t)
-            throwFrontendError("Unable to load screen to SFML!");
-
-        sprite.setTexture(texture, true);
         window.draw(sprite);
         window.display();
     }
@@ -233,7 +308,7 @@ void throwFrontendError(std::string message);
     }
 
     bool Frontend::getExitBtn() {
-        return sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Escape) || !window.isOpen();
+        return sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Escape) || windowClosed;
     }
 
     void handleSFMLEvents() {
@@ -241,8 +316,10 @@ void throwFrontendError(std::string message);
             while (const std::optional event = window.pollEvent())
             {
                 // Request for closing the window
-                if (event->is<sf::Event::Closed>())
+                if (event->is<sf::Event::Closed>()) {
                     window.close();
+                    windowClosed = true;
+                }
             }
         }
     }
@@ -1,15 +1,88 @@
 /*
     Simple graphics library to draw shapes to a virtual screen.
 
-    Each function in the SGraphics namespace will draw to the screen buffer in screen.hpp: uint8_t screenBuff[SCREEN_HEIGHT][SCREEN_WIDTH][3]
+    Each function in the SGraphics namespace will draw to the screen buffer in screen.hpp: screen.screenBuff[y][x]
 */
 
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstring>
 #include "graphics.hpp"
+#include "pixel-kernels.hpp"
+#include "assets.hpp"
+
+//area of the screen the current thread is allowed to draw in (inclusive). Each render worker gets its own, and it starts out
+//empty since the resolution isn't known yet (set_clip/reset_clip have to be called before drawing)
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} clip_rect;
+
+thread_local clip_rect clip = {0, 0, -1, -1};
+
+//while recording, spans are collected here instead of being drawn to the screen
+thread_local std::vector<SGraphics::span>* recording = nullptr;
+
+//shapes are recorded around this point (far enough from the edges of the recording clip rect for any cacheable shape)
+#define RECORD_ORIGIN (1 << 12)
+
+//spans shorter than this are filled in place instead of with Kernels::fill_span
+#define SHORT_SPAN_PIXELS 8
+
+void draw_span(int y, int x0, int x1, pixel_t c);
+void fill_rect(int x0, int y0, int x1, int y1, pixel_t c);
+void copy_pixels(pixel_t* dst, const pixel_t* src, int count);
+pixel_t to_pixel(SGraphics::Color c);
+void rotate_point(SGraphics::pixel& p, SGraphics::pixel& c, SGraphics::rotation r);
+bool edge_range(long long a, long long c, int& x0, int& x1);
+bool pull_in_line(SGraphics::pixel& one, SGraphics::pixel& two);
+
+//see rotate_point
+#define ROTATE_SNAP_BIAS 1e-3f
+
+//lines reaching further off screen than this get cut down first, so the exact line math can't overflow
+#define LINE_GUARD_RANGE (1 << 20)
+
+//implicit form of a rotated ellipse centered on the origin: A*x^2 + B*x*y + C*y^2 <= 1
+typedef struct {
+    double A;
+    double B;
+    double C;
+    int rows; //how many rows above/below the center the ellipse covers
+    bool valid;
+} ellipse_coeffs;
+
+ellipse_coeffs make_ellipse(double a, double b, float rot);
+bool ellipse_row(ellipse_coeffs& e, int dy, int& x0, int& x1);
 
-void draw_pixel(SGraphics::pixel p, SGraphics::Color c);
-void rotate_point(SGraphics::pixel& p, SGraphics::pixel& c, float r);
+/**
+ * @brief Work out the sin and cos of a rotation once, so shapes don't have to for every corner
+ * 
+ * @param rot in degrees
+ * @return rotation 
+ */
+SGraphics::rotation SGraphics::make_rotation(float rot)
+{
+    float turn = fmod(rot, 360);
+    if(turn < 0)
+        turn += 360;
+
+    //quarter turns are exact, so shapes turned by them keep perfectly straight edges
+    if(turn == 0)
+        return {0, 1};
+    if(turn == 90)
+        return {1, 0};
+    if(turn == 180)
+        return {0, -1};
+    if(turn == 270)
+        return {-1, 0};
+
+    float r = turn * (3.1415926 / 180); //degrees to radians
+    return {sinf(r), cosf(r)};
+}
 
 /**
  * @brief Draws a rectangle to screenBuff
@@ -23,7 +96,7 @@ void rotate_point(SGraphics::pixel& p, SGraphics::pixel& c, float r);
  * @param color 
  * @param fill 
  */
-void SGraphics::draw_rect(pixel loc, int width, int height, float rot, Color color, bool fill) 
+void SGraphics::draw_rect(pixel loc, int width, int height, rotation rot, Color color, bool fill) 
 {
     //get points for rect
     pixel p1;
@@ -34,6 +107,12 @@ void SGraphics::draw_rect(pixel loc, int width, int height, float rot, Color col
     width /= 2;
     height /= 2;
 
+    if(fill && rot.sine == 0 && rot.cosine == 1) {
+        //not rotated, the rectangle is just a block of rows
+        fill_rect(loc.x - width, loc.y - height, loc.x + width, loc.y + height, to_pixel(color));
+        return;
+    }
+
     p1.x = loc.x - width;
     p1.y = loc.y - height;
 
@@ -79,7 +158,7 @@ void SGraphics::draw_rect(pixel loc, int width, int height, float rot, Color col
  * @param color 
  * @param fill 
  */
-void SGraphics::draw_triangle(pixel loc, int width, int height, float rot, Color color, bool fill) 
+void SGraphics::draw_triangle(pixel loc, int width, int height, rotation rot, Color color, bool fill) 
 {
     //get points for triangle
     pixel p1;
@@ -111,6 +190,8 @@ void SGraphics::draw_triangle(pixel loc, int width, int height, float rot, Color
  * @brief Draw an ellipse to screenBuff
  * 
  * Center is located at location loc. Circles are ellipses that have width==height.
+ * The ellipse is rasterized one row at a time: the left and right edges of each row are solved for directly
+ * from the (rotated) ellipse equation, so only covered pixels are ever touched.
  * 
  * @param loc
  * @param width 
@@ -121,32 +202,32 @@ void SGraphics::draw_triangle(pixel loc, int width, int height, float rot, Color
  */
 void SGraphics::draw_ellipse(pixel loc, int width, int height, float rot, Color color, bool fill) 
 {
-    //TODO: allow for height and width to
-    int radius = width/2;
+    double a = width / 2.0;
+    double b = height / 2.0;
 
-    //  Bounding box for scanline drawing
-    int startX = loc.x - radius;
-    int endX = loc.x + radius;
+    if(a <= 0 || b <= 0)
+        return;
 
-    int startY = loc.y - radius;
-    int endY = loc.y + radius;
+    ellipse_coeffs outer = make_ellipse(a, b, rot);
+    ellipse_coeffs inner = make_ellipse(a-1, b-1, rot); //only used for outlines (ring between outer and inner ellipse)
+    pixel_t px = to_pixel(color);
 
-    pixel p;
+    int x0, x1;
+    int ix0, ix1;
+    int firstRow = std::max(-outer.rows, clip.y0 - loc.y);
+    int lastRow = std::min(outer.rows, clip.y1 - loc.y);
 
-    //  Draws circle via scanline
-    for(int x = startX; x <= endX; x++)
-    {
-        for (int y = startY; y <= endY; y++)
-        {
-            int distX = abs(loc.x - x), distY = abs(loc.y - y); 
-
-            //  If inside circle 
-            if(distX * distX + distY * distY <= radius * radius)
-            {
-                p.x = x;
-                p.y = y;
-                draw_pixel(p, color);
-            }
+    for(int dy = firstRow; dy <= lastRow; dy++) {
+        if(!ellipse_row(outer, dy, x0, x1))
+            continue;
+
+        if(fill || !ellipse_row(inner, dy, ix0, ix1) || ix0 > ix1) {
+            draw_span(loc.y + dy, loc.x + x0, loc.x + x1, px);
+        }
+        else {
+            //outline: only draw the parts of the outer row not covered by the inner ellipse
+            draw_span(loc.y + dy, loc.x + x0, loc.x + ix0 - 1, px);
+            draw_span(loc.y + dy, loc.x + ix1 + 1, loc.x + x1, px);
         }
     }
 }
@@ -164,42 +245,38 @@ void SGraphics::draw_polygon(pixel one, pixel two, pixel three, Color color, boo
 {
     if(fill) {
         //  Bounding box for triangle
-        int startX = std::min({one.x, two.x, three.x});
-        int endX = std::max({one.x, two.x, three.x});
-
-        int startY = std::min({one.y, two.y, three.y});
-        int endY = std::max({one.y, two.y, three.y});
+        int startY = std::max(std::min({one.y, two.y, three.y}), clip.y0);
+        int endY = std::min(std::max({one.y, two.y, three.y}), clip.y1);
 
         // Compute the area of the triangle (using the determinant)
-        float denom = (two.y - three.y) * (one.x - three.x) + (three.x - two.x) * (one.y - three.y);
+        long long denom = (long long)(two.y - three.y) * (one.x - three.x) + (long long)(three.x - two.x) * (one.y - three.y);
 
         //  No divide by 0 or very small triangles
-        if (std::abs(denom) < 1e-5f)
+        if (denom == 0)
             return;
 
-        //temp variable for holding coordinates
-        pixel p;
+        //  The barycentric weights (scaled by denom) are linear in x along a row: w = a*x + c
+        //  A pixel is inside when all three weights have the same sign as denom, so each weight limits the row to a range of x
+        long long s = denom > 0 ? 1 : -1;
+
+        long long a0 = s * (two.y - three.y);
+        long long a1 = s * (three.y - one.y);
+        long long a2 = -a0 - a1; //w2 = denom - w0 - w1
 
-        //  Barycentric to determine if point is in triangle
-        for(int x = startX; x <= endX; x++)
+        pixel_t px = to_pixel(color);
+
+        for(int y = startY; y <= endY; y++)
         {
-            for(int y = startY; y <= endY; y++)
-            {
-                float w0, w1, w2;
-
-                // Compute the barycentric weights
-                w0 = ((two.y - three.y) * (x - three.x) + (three.x - two.x) * (y - three.y)) / denom;
-                w1 = ((three.y - one.y) * (x - three.x) + (one.x - three.x) * (y - three.y)) / denom;
-                w2 = 1.0f - w0 - w1;
-
-                //  If weights are all valid, inside triangle
-                if(w0 >= 0 && w1 >= 0 && w2 >= 0)
-                {
-                    p.x = x;
-                    p.y = y;
-                    draw_pixel(p, color);
-                }
-            }
+            long long c0 = s * (-(long long)(two.y - three.y) * three.x + (long long)(three.x - two.x) * (y - three.y));
+            long long c1 = s * (-(long long)(three.y - one.y) * three.x + (long long)(one.x - three.x) * (y - three.y));
+            long long c2 = s * denom - c0 - c1;
+
+            int x0 = INT_MIN;
+            int x1 = INT_MAX;
+
+            //  If weights are all valid, inside triangle
+            if(edge_range(a0, c0, x0, x1) && edge_range(a1, c1, x0, x1) && edge_range(a2, c2, x0, x1))
+                draw_span(y, x0, x1, px);
         }
     }
     else {
@@ -211,7 +288,8 @@ void SGraphics::draw_polygon(pixel one, pixel two, pixel three, Color color, boo
 }
 
 /**
- * @brief Draw a line between two points on the screen
+ * @brief Draw a line between two points on the screen. The line is clipped to the screen before anything is drawn, 
+ * so only the visible part of it costs anything
  * 
  * @param one
  * @param two
@@ -219,73 +297,552 @@ void SGraphics::draw_polygon(pixel one, pixel two, pixel three, Color color, boo
  */
 void SGraphics::draw_line(pixel one, pixel two, Color color) 
 {
-    //  Slopes calculation
-    int x0 = one.x, x1 = two.x;
-    int y0 = one.y, y1 = two.y;
+    pixel_t px = to_pixel(color);
+
+    if(!pull_in_line(one, two))
+        return;
 
-    int dx = abs(two.x - one.x);
-    int dy = abs(two.y - one.y);
+    //straight lines are just spans
+    if(one.y == two.y) {
+        draw_span(one.y, std::min(one.x, two.x), std::max(one.x, two.x), px);
+        return;
+    }
 
-    int signx = (one.x < two.x) ? 1 : -1;
-    int signy = (one.y < two.y) ? 1 : -1;
+    if(one.x == two.x) {
+        int y0 = std::max(std::min(one.y, two.y), clip.y0);
+        int y1 = std::min(std::max(one.y, two.y), clip.y1);
+        if(one.x < clip.x0 || one.x > clip.x1 || y0 > y1)
+            return;
 
-    int err = dx - dy;
+        if(recording) {
+            for(int y=y0; y<=y1; y++)
+                recording->push_back({y, one.x, one.x});
+            return;
+        }
 
-    //  First pixel
-    SGraphics::pixel p;
-    p.x = x0;
-    p.y = y0;
-    draw_pixel(p, color);
+        for(int y=y0; y<=y1; y++)
+            screen.screenBuff[y][one.x] = px;
+        screen.markDirty(one.x, y0, one.x, y1);
+        return;
+    }
 
-    //  Draw Pixels
-    while(true)
-    {
-        // End condition
-        if (x0 == x1 && y0 == y1)
-            break;
+    /*
+        Walk the line along its major axis (the one that changes the most). Pixel i is i steps along the major axis and
+        m(i) = (2*i*minorLen + majorLen - 1) / (2*majorLen) steps along the minor one, which is exactly where Bresenham puts it.
+        Since both are monotonic in i, the range of i inside the clip rect can be solved for directly instead of stepped through.
+    */
+    bool xMajor = std::abs((long long)two.x - one.x) >= std::abs((long long)two.y - one.y);
+
+    long long a0 = xMajor ? one.x : one.y; //start on the major axis
+    long long b0 = xMajor ? one.y : one.x; //start on the minor axis
+    long long da = (xMajor ? two.x : two.y) - a0;
+    long long db = (xMajor ? two.y : two.x) - b0;
+    int sa = da < 0 ? -1 : 1;
+    int sb = db < 0 ? -1 : 1;
+    da = std::abs(da);
+    db = std::abs(db);
+
+    long long aLo = xMajor ? clip.x0 : clip.y0, aHi = xMajor ? clip.x1 : clip.y1;
+    long long bLo = xMajor ? clip.y0 : clip.x0, bHi = xMajor ? clip.y1 : clip.x1;
+
+    //range of steps inside the clip rect along each axis (in steps away from the start point)
+    long long iFirst = sa > 0 ? aLo - a0 : a0 - aHi;
+    long long iLast  = sa > 0 ? aHi - a0 : a0 - aLo;
+    long long mFirst = sb > 0 ? bLo - b0 : b0 - bHi;
+    long long mLast  = sb > 0 ? bHi - b0 : b0 - bLo;
+
+    //first step i where m(i) reaches m
+    auto firstStep = [&](long long m) -> long long {
+        if(m <= 0)
+            return 0;
+        return ((2*m - 1) * da) / (2*db) + 1;
+    };
+
+    iFirst = std::max({iFirst, firstStep(mFirst), 0LL});
+    iLast = std::min({iLast, firstStep(mLast + 1) - 1, da});
+    if(iFirst > iLast)
+        return;
+
+    //regular bresenham from the first visible pixel on, with no bounds checks
+    long long m = (2*iFirst*db + da - 1) / (2*da);
+    long long err = 2*(iFirst+1)*db - (2*m + 1)*da; //m goes up on the next step once this is positive
+
+    int a = a0 + sa*iFirst;
+    int b = b0 + sb*m;
+    for(long long i=iFirst; i<=iLast; i++) {
+        int x = xMajor ? a : b;
+        int y = xMajor ? b : a;
+        if(recording) {
+            recording->push_back({y, x, x});
+        } else {
+            screen.screenBuff[y][x] = px;
+            screen.markRow(y, x, x);
+        }
 
-        int err2 = 2 * err;
+        a += sa;
+        if(err > 0) {
+            b += sb;
+            err -= 2*da;
+        }
+        err += 2*db;
+    }
+}
 
-        if (err2 > -dy)
-        {
-            err -= dy;
-            x0 += signx;
+/**
+ * @brief Copy a loaded image to the screen, centered on loc. Only the opaque runs of each row are copied
+ * 
+ * @param loc
+ * @param image index of the image in Assets
+ */
+void SGraphics::draw_image(pixel loc, int image)
+{
+    const Assets::Image& img = Assets::get(image);
+    int left = loc.x - img.width/2;
+    int top = loc.y - img.height/2;
+
+    int y0 = std::max(top, clip.y0);
+    int y1 = std::min(top + img.height - 1, clip.y1);
+
+    for(int y=y0; y<=y1; y++) {
+        size_t count;
+        const Assets::Run* runs = Assets::rowRuns(img, y - top, count);
+        const pixel_t* src = Assets::rowPixels(img, y - top);
+
+        for(size_t i=0; i<count; i++) {
+            int x0 = std::max(left + runs[i].x, clip.x0);
+            int x1 = std::min(left + runs[i].x + runs[i].length - 1, clip.x1);
+            if(x0 > x1)
+                continue;
+
+            memcpy(&screen.screenBuff[y][x0], &src[x0 - left], (x1 - x0 + 1) * sizeof(pixel_t));
+            screen.markRow(y, x0, x1);
         }
+    }
+}
 
-        if (err2 < dx)
-        {
-            err += dx;
-            y0 += signy;
+/**
+ * @brief Draw laid out text with the built in font. Glyphs are filled from the font atlas, skipping any outside the clip rect
+ * 
+ * @param loc top left corner of the text
+ * @param glyphs placements from Font::layout
+ * @param count 
+ * @param scale size of each font pixel on screen
+ * @param color 
+ */
+void SGraphics::draw_text(pixel loc, const Font::Placement* glyphs, size_t count, int scale, Color color)
+{
+    pixel_t px = to_pixel(color);
+
+    for(size_t i=0; i<count; i++) {
+        int left = loc.x + glyphs[i].x*scale;
+        int top = loc.y + glyphs[i].y*scale;
+        if(left > clip.x1 || top > clip.y1 || left + GLYPH_WIDTH*scale <= clip.x0 || top + GLYPH_HEIGHT*scale <= clip.y0)
+            continue;
+
+        size_t numRuns;
+        const Font::Run* runs = Font::glyphRuns(glyphs[i].glyph, numRuns);
+
+        for(size_t r=0; r<numRuns; r++) {
+            if(scale == 1)
+                draw_span(top + runs[r].y, left + runs[r].x0, left + runs[r].x1, px);
+            else
+                fill_rect(left + runs[r].x0*scale, top + runs[r].y*scale, left + (runs[r].x1+1)*scale - 1, top + (runs[r].y+1)*scale - 1, px);
+        }
+    }
+}
+
+/**
+ * @brief Draw a batch of size x size squares, each in its own color (particles)
+ *
+ * @param points top left corners and colors
+ * @param count
+ * @param size
+ */
+void SGraphics::draw_points(const DrawPoint* points, size_t count, int size)
+{
+    //single pixels (the usual particle) are written straight into the frame, there are too many of them to go through draw_span
+    if(size == 1 && !recording) {
+        const clip_rect box = clip;
+        const FrameView frame = screen.screenBuff;
+
+        for(size_t i=0; i<count; i++) {
+            const DrawPoint& p = points[i];
+            if(p.x < box.x0 || p.x > box.x1 || p.y < box.y0 || p.y > box.y1)
+                continue;
+
+            frame[p.y][p.x] = p.color;
+            screen.markRow(p.y, p.x, p.x);
+        }
+        return;
+    }
+
+    for(size_t i=0; i<count; i++) {
+        const DrawPoint& p = points[i];
+        if(p.y > clip.y1 || p.y + size <= clip.y0)
+            continue;
+
+        for(int y=p.y; y<p.y+size; y++)
+            draw_span(y, p.x, p.x + size - 1, p.color);
+    }
+}
+
+/**
+ * @brief Draw a window of tilemap cells. The window is drawn one band of cells at a time: for each tile in the band the
+ * visible rows are copied from the tileset (only its opaque runs if the tile has transparent pixels). Only the cells
+ * inside the clip rect are visited
+ *
+ * @param loc top left corner of the first cell
+ * @param window
+ * @param cells tile index of every cell in the window, row by row (0 is empty)
+ */
+void SGraphics::draw_tiles(pixel loc, const TileWindow& window, const uint16_t* cells)
+{
+    if(clip.x1 < loc.x || clip.y1 < loc.y)
+        return;
+
+    const Assets::Image& img = Assets::get(window.image);
+    int s = window.tileSize;
+    int setColumns = img.width / s;
+    int numTiles = setColumns * (img.height / s);
+
+    //cells touching the clip rect
+    int c0 = std::max(clip.x0 - loc.x, 0) / s;
+    int c1 = std::min((clip.x1 - loc.x) / s, window.columns - 1);
+    int r0 = std::max(clip.y0 - loc.y, 0) / s;
+    int r1 = std::min((clip.y1 - loc.y) / s, window.rows - 1);
+
+    for(int r=r0; r<=r1; r++) {
+        int top = loc.y + r*s;
+        int y0 = std::max(top, clip.y0);
+        int y1 = std::min(top + s - 1, clip.y1);
+        const uint16_t* row = cells + (size_t)r*window.columns;
+
+        //every row of the band is marked with the extent of the tiles drawn in it (a little more than what was written
+        //where tiles have transparent pixels, which only means a few extra pixels get erased and presented)
+        int bandX0 = INT_MAX;
+        int bandX1 = INT_MIN;
+
+        for(int c=c0; c<=c1; c++) {
+            int tile = row[c];
+            if(tile == 0 || tile > numTiles)
+                continue;
+
+            int left = loc.x + c*s;
+            int x0 = std::max(left, clip.x0);
+            int x1 = std::min(left + s - 1, clip.x1);
+            int srcX = ((tile-1) % setColumns) * s;
+            int srcTop = ((tile-1) / setColumns) * s - top;
+
+            bandX0 = std::min(bandX0, x0);
+            bandX1 = std::max(bandX1, x1);
+
+            for(int y=y0; y<=y1; y++) {
+                size_t count;
+                const Assets::Run* runs = Assets::rowRuns(img, srcTop + y, count);
+                const pixel_t* src = Assets::rowPixels(img, srcTop + y) + srcX; //pixel of the tile under left
+                pixel_t* dst = screen.screenBuff[y];
+
+                //most tilesets are solid, then the row is copied without looking at its runs
+                if(count == 1 && runs[0].x == 0 && runs[0].length == img.width) {
+                    copy_pixels(&dst[x0], &src[x0 - left], x1 - x0 + 1);
+                    continue;
+                }
+
+                //runs are sorted, skip to the first one reaching into this tile
+                const Assets::Run* run = std::lower_bound(runs, runs + count, srcX, [](const Assets::Run& sr, int x) {
+                    return sr.x + sr.length <= x;
+                });
+
+                for(; run != runs + count && run->x < srcX + s; ++run) {
+                    int rx0 = std::max(left + run->x - srcX, x0);
+                    int rx1 = std::min(left + run->x + run->length - 1 - srcX, x1);
+                    if(rx0 <= rx1)
+                        copy_pixels(&dst[rx0], &src[rx0 - left], rx1 - rx0 + 1);
+                }
+            }
         }
 
-        //  Draw to screen buffer
-        p.x = x0;
-        p.y = y0;
-        draw_pixel(p, color);
+        if(bandX0 <= bandX1) {
+            for(int y=y0; y<=y1; y++)
+                screen.markRow(y, bandX0, bandX1);
+        }
+    }
+}
+
+/*
+    Liang-Barsky clip of a line to the square LINE_GUARD_RANGE around the screen. Lines that are already inside it
+    (any line a script would normally draw) are left alone so their pixels stay exact. Returns false if nothing is left
+*/
+bool pull_in_line(SGraphics::pixel& one, SGraphics::pixel& two)
+{
+    const int lo = -LINE_GUARD_RANGE, hi = LINE_GUARD_RANGE;
+    if(std::min(one.x, two.x) >= lo && std::max(one.x, two.x) <= hi && std::min(one.y, two.y) >= lo && std::max(one.y, two.y) <= hi)
+        return true;
+
+    double dx = (double)two.x - one.x;
+    double dy = (double)two.y - one.y;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { (double)one.x - lo, hi - (double)one.x, (double)one.y - lo, hi - (double)one.y };
+    double t0 = 0, t1 = 1;
+
+    for(int i=0; i<4; i++) {
+        if(p[i] == 0) {
+            if(q[i] < 0)
+                return false; //parallel to this edge and outside of it
+            continue;
+        }
+
+        double t = q[i] / p[i];
+        if(p[i] < 0)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+    }
+
+    if(t0 > t1)
+        return false;
+
+    SGraphics::pixel start = one;
+    one.x = (int)lround(start.x + t0*dx);
+    one.y = (int)lround(start.y + t0*dy);
+    two.x = (int)lround(start.x + t1*dx);
+    two.y = (int)lround(start.y + t1*dy);
+    return true;
+}
+
+/**
+ * @brief Run a draw call without touching the screen, collecting the spans it would have filled instead
+ * 
+ * @param out spans relative to the location passed to draw, sorted by row with overlapping spans merged
+ * @param draw draws the shape centered on the location it is given
+ */
+void SGraphics::record_spans(std::vector<span>& out, const std::function<void(pixel loc)>& draw)
+{
+    clip_rect saved = clip;
+    clip = {0, 0, 2*RECORD_ORIGIN, 2*RECORD_ORIGIN};
+
+    out.clear();
+    recording = &out;
+    draw({RECORD_ORIGIN, RECORD_ORIGIN});
+    recording = nullptr;
+    clip = saved;
+
+    std::sort(out.begin(), out.end(), [](const span& a, const span& b) {
+        return a.y < b.y || (a.y == b.y && a.x0 < b.x0);
+    });
+
+    //outlines are made of single pixels from lines, join them back up into runs
+    size_t n = 0;
+    for(size_t i=0; i<out.size(); i++) {
+        if(n > 0 && out[n-1].y == out[i].y && out[i].x0 <= out[n-1].x1 + 1)
+            out[n-1].x1 = std::max(out[n-1].x1, out[i].x1);
+        else
+            out[n++] = out[i];
+    }
+    out.resize(n);
+
+    for(span& sp : out) {
+        sp.y -= RECORD_ORIGIN;
+        sp.x0 -= RECORD_ORIGIN;
+        sp.x1 -= RECORD_ORIGIN;
+    }
+}
+
+/**
+ * @brief Fill a list of recorded spans in one color
+ * 
+ * @param loc where the recorded shape is centered
+ * @param spans 
+ * @param color 
+ */
+void SGraphics::draw_spans(pixel loc, const std::vector<span>& spans, Color color)
+{
+    pixel_t px = to_pixel(color);
+
+    //skip straight to the first row inside the clip rect
+    auto it = std::lower_bound(spans.begin(), spans.end(), clip.y0 - loc.y, [](const span& sp, int y) {
+        return sp.y < y;
+    });
+
+    for(; it != spans.end() && loc.y + it->y <= clip.y1; ++it)
+        draw_span(loc.y + it->y, loc.x + it->x0, loc.x + it->x1, px);
+}
+
+void SGraphics::set_clip(int x0, int y0, int x1, int y1)
+{
+    clip.x0 = std::max(x0, 0);
+    clip.y0 = std::max(y0, 0);
+    clip.x1 = std::min(x1, screen.width-1);
+    clip.y1 = std::min(y1, screen.height-1);
+}
+
+void SGraphics::reset_clip()
+{
+    set_clip(0, 0, screen.width-1, screen.height-1);
+}
+
+/*
+    Fill the pixels [x0, x1] on row y with one color. Span is clipped first so the inner loop doesn't need any bounds checks
+*/
+void draw_span(int y, int x0, int x1, pixel_t c)
+{
+    if(y<clip.y0 || y>clip.y1)
+        return;
+
+    x0 = std::max(x0, clip.x0);
+    x1 = std::min(x1, clip.x1);
+
+    if(x0 > x1)
+        return;
+
+    if(recording) {
+        recording->push_back({y, x0, x1});
+        return;
+    }
+
+    //short spans (outlines are mostly single pixels) aren't worth a call into the fill kernels
+    if(x1 - x0 < SHORT_SPAN_PIXELS) {
+        for(int x=x0; x<=x1; x++)
+            screen.screenBuff[y][x] = c;
+    }
+    else
+        Kernels::fill_span(&screen.screenBuff[y][x0], x1-x0+1, c);
+
+    screen.markRow(y, x0, x1);
+}
+
+/*
+    Fill every pixel in the (inclusive) box from (x0, y0) to (x1, y1), clipped to the clip rect
+*/
+void fill_rect(int x0, int y0, int x1, int y1, pixel_t c)
+{
+    x0 = std::max(x0, clip.x0);
+    y0 = std::max(y0, clip.y0);
+    x1 = std::min(x1, clip.x1);
+    y1 = std::min(y1, clip.y1);
+
+    if(x0 > x1 || y0 > y1)
+        return;
+
+    if(recording) {
+        for(int y=y0; y<=y1; y++)
+            recording->push_back({y, x0, x1});
+        return;
     }
+
+    Kernels::fill_rect(&screen.screenBuff[y0][x0], screen.screenBuff.stride, x1-x0+1, y1-y0+1, c);
+    screen.markDirty(x0, y0, x1, y1);
 }
 
 /*
-    Simple helper method to draw a pixel on the screen without causing an OOB error
+    Copy count pixels (tile rows are short, so they aren't worth a call to memcpy)
 */
-void draw_pixel(SGraphics::pixel p, SGraphics::Color c) 
+void copy_pixels(pixel_t* dst, const pixel_t* src, int count)
 {
-    if(p.x>=0 && p.x<SCREEN_WIDTH && p.y>=0 && p.y<SCREEN_HEIGHT) {
-        screen.screenBuff[p.y][p.x][0] = c.r;
-        screen.screenBuff[p.y][p.x][1] = c.g;
-        screen.screenBuff[p.y][p.x][2] = c.b;
+    if(count < SHORT_SPAN_PIXELS*4) {
+        for(int i=0; i<count; i++)
+            dst[i] = src[i];
     }
+    else
+        memcpy(dst, src, count * sizeof(pixel_t));
+}
+
+/*
+    Pack an SGraphics color into the screen's pixel format
+*/
+pixel_t to_pixel(SGraphics::Color c)
+{
+    return Screen::packColor(c.r, c.g, c.b);
+}
+
+/*
+    Narrow [x0, x1] to the values of x where a*x + c >= 0. Returns false if nothing is left
+*/
+bool edge_range(long long a, long long c, int& x0, int& x1)
+{
+    if(a == 0)
+        return c >= 0;
+
+    if(a > 0) {
+        //x >= -c/a (rounded up)
+        long long n = -c;
+        long long lo = n / a;
+        if(n % a != 0 && n > 0)
+            lo++;
+        if(lo > x0)
+            x0 = (int)std::min(lo, (long long)INT_MAX);
+    }
+    else {
+        //x <= c/-a (rounded down)
+        long long d = -a;
+        long long hi = c / d;
+        if(c % d != 0 && c < 0)
+            hi--;
+        if(hi < x1)
+            x1 = (int)std::max(hi, (long long)INT_MIN);
+    }
+
+    return x0 <= x1;
+}
+
+/*
+    Build the implicit equation for an ellipse with half-width a and half-height b rotated rot degrees (same direction as rotate_point)
+*/
+ellipse_coeffs make_ellipse(double a, double b, float rot)
+{
+    ellipse_coeffs e;
+    e.valid = a > 0 && b > 0;
+    e.rows = -1;
+
+    if(!e.valid)
+        return e;
+
+    double r = rot * (3.1415926 / 180); //degrees to radians
+    double s = sin(r);
+    double c = cos(r);
+
+    double ia = 1.0 / (a*a);
+    double ib = 1.0 / (b*b);
+
+    e.A = c*c*ia + s*s*ib;
+    e.B = 2*c*s*(ia - ib);
+    e.C = s*s*ia + c*c*ib;
+
+    //vertical extent of the ellipse (where the row equation stops having real solutions)
+    e.rows = (int)floor(sqrt(e.A) * a * b + 1e-6);
+
+    return e;
+}
+
+/*
+    Solve the ellipse equation for row dy (relative to the center). Returns false if the row doesn't intersect the ellipse,
+    otherwise x0 and x1 are set to the first and last covered pixel of the row (also relative to the center)
+*/
+bool ellipse_row(ellipse_coeffs& e, int dy, int& x0, int& x1)
+{
+    if(!e.valid || dy < -e.rows || dy > e.rows)
+        return false;
+
+    double by = e.B * dy;
+    double disc = by*by - 4*e.A*(e.C*dy*dy - 1);
+
+    if(disc < 0)
+        return false;
+
+    double root = sqrt(disc);
+    x0 = (int)ceil((-by - root) / (2*e.A) - 1e-6);
+    x1 = (int)floor((-by + root) / (2*e.A) + 1e-6);
+
+    return x0 <= x1;
 }
 
 /*
-    Rotate a pixel p around point c in r degrees
+    Rotate a pixel p around point c by rotation r
 */
-void rotate_point(SGraphics::pixel& p, SGraphics::pixel& center, float r) 
+void rotate_point(SGraphics::pixel& p, SGraphics::pixel& center, SGraphics::rotation r) 
 {
-    r = r * (3.1415926 / 180); //degrees to radians
-    
-    float s = sin(r);
-    float c = cos(r);
+    float s = r.sine;
+    float c = r.cosine;
 
     // translate point back to origin:
     p.x -= center.x;
@@ -295,7 +852,8 @@ void rotate_point(SGraphics::pixel& p, SGraphics::pixel& center, float r)
     float xnew = p.x * c - p.y * s;
     float ynew = p.x * s + p.y * c;
 
-    // translate point back:
-    p.x = xnew + center.x;
-    p.y = ynew + center.y;
+    // translate point back: the rotated offset is snapped to a pixel on its own, so a shape comes out the same wherever it is drawn
+    // (the bias keeps float error from pushing offsets that should be whole pixels down by one)
+    p.x = (int)floor(xnew + ROTATE_SNAP_BIAS) + center.x;
+    p.y = (int)floor(ynew + ROTATE_SNAP_BIAS) + center.y;
 }
\ No newline at end of file
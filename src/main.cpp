@@ -9,9 +9,20 @@ int main(int argc, char** argv) {
     std::vector<std::string> fileLines;
 
     #if BUILD_FOR_RASPI
-    while(true) {
+    //same options as on pc (squiggly --capture <folder>, ...), just without a filename
+    if(parse_options(argc, argv, 1))
+        return 1;
+
+    std::string captureRoot = captureFolder;
+    Workers::start(renderThreads);
+
+    for(int run=1; true; run++) {
         fileLines.clear(); //tokenizer clears filelines automatically, but let's clear it here just in case
 
+        //every script started from the menu is captured to its own folder, so frame numbers starting over don't overwrite the last one
+        if(!captureRoot.empty())
+            captureFolder = captureRoot + "/run_" + std::to_string(run);
+
         std::string path = run_menu();
         read_file((char*)path.c_str(), fileLines);
         run_squiggly(fileLines);
@@ -21,6 +32,13 @@ int main(int argc, char** argv) {
 
     return 0;
     #else
-    return parse_args(argc, argv, fileLines) || run_squiggly(fileLines);
+    if(parse_args(argc, argv, fileLines))
+        return 1;
+
+    Workers::start(renderThreads);
+    int result = run_squiggly(fileLines);
+    Workers::stop();
+
+    return result;
     #endif
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "particles.hpp"
+
+using namespace Particles;
+
+float randomUnit(uint32_t& seed);
+void integrate(float* __restrict x, float* __restrict y, float* __restrict vx, float* __restrict vy, float* __restrict age,
+               size_t n, float ax, float ay, float dt);
+size_t compact(float* __restrict x, float* __restrict y, float* __restrict vx, float* __restrict vy, float* __restrict age,
+               float* __restrict life, pixel_t* __restrict color, size_t n);
+
+std::vector<Emitter> emitters;
+std::vector<int> freeEmitters; //ids of freed emitters, reused before the list grows
+
+int Particles::create(int capacity)
+{
+    Emitter e;
+    e.capacity = std::clamp(capacity, 1, MAX_PARTICLES);
+    e.count = 0;
+
+    //buffers are allocated once, emitting and updating never reallocate
+    size_t padded = (e.capacity + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK * PARTICLE_BLOCK;
+    e.x.resize(padded);
+    e.y.resize(padded);
+    e.vx.resize(padded);
+    e.vy.resize(padded);
+    e.age.resize(padded);
+    e.life.resize(padded);
+    e.color.resize(padded);
+
+    //defaults: white single pixel sparks going out in every direction
+    e.speedMin = 20;
+    e.speedMax = 60;
+    e.angle = 0;
+    e.spread = 360;
+    e.lifeMin = 0.5f;
+    e.lifeMax = 1;
+    e.emitColor = Screen::packColor(255, 255, 255);
+    e.gravityX = 0;
+    e.gravityY = 0;
+    e.size = 1;
+    e.seed = (uint32_t)rand() | 1; //xorshift state can't be 0
+
+    if(!freeEmitters.empty()) {
+        int id = freeEmitters.back();
+        freeEmitters.pop_back();
+        emitters[id] = std::move(e);
+        return id;
+    }
+
+    emitters.push_back(std::move(e));
+    return emitters.size() - 1;
+}
+
+void Particles::destroy(Emitter& e)
+{
+    e = Emitter(); //buffers go with the old value, an empty emitter has nothing to move or draw
+    freeEmitters.push_back(&e - emitters.data());
+}
+
+Emitter* Particles::get(int id)
+{
+    if(id < 0 || (size_t)id >= emitters.size() || emitters[id].capacity == 0)
+        return nullptr;
+
+    return &emitters[id];
+}
+
+void Particles::emit(Emitter& e, int count, float x, float y)
+{
+    size_t n = std::min((size_t)std::max(count, 0), e.capacity - e.count);
+
+    for(size_t i=e.count; i<e.count+n; i++) {
+        float dir = (e.angle + e.spread * (randomUnit(e.seed) - 0.5f)) * (3.1415926f / 180); //degrees to radians
+        float speed = e.speedMin + (e.speedMax - e.speedMin) * randomUnit(e.seed);
+
+        e.x[i] = x;
+        e.y[i] = y;
+        e.vx[i] = cosf(dir) * speed;
+        e.vy[i] = sinf(dir) * speed;
+        e.age[i] = 0;
+        e.life[i] = e.lifeMin + (e.lifeMax - e.lifeMin) * randomUnit(e.seed);
+        e.color[i] = e.emitColor;
+    }
+
+    e.count += n;
+}
+
+/*
+    Move n particles (rounded up to a whole block) forward by dt seconds. Each block is a fixed size loop over plain arrays
+    that can't overlap, so the compiler turns it into a few vector instructions
+*/
+void integrate(float* __restrict x, float* __restrict y, float* __restrict vx, float* __restrict vy, float* __restrict age,
+               size_t n, float ax, float ay, float dt)
+{
+    size_t end = (n + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK * PARTICLE_BLOCK;
+    for(size_t b=0; b<end; b+=PARTICLE_BLOCK) {
+        float* __restrict bx = x + b;
+        float* __restrict by = y + b;
+        float* __restrict bvx = vx + b;
+        float* __restrict bvy = vy + b;
+        float* __restrict bage = age + b;
+
+        for(int i=0; i<PARTICLE_BLOCK; i++) {
+            bvx[i] += ax;
+            bvy[i] += ay;
+            bx[i] += bvx[i] * dt;
+            by[i] += bvy[i] * dt;
+            bage[i] += dt;
+        }
+    }
+}
+
+/*
+    Remove the dead particles by moving the last live particle into each one's place. Only a few particles die each frame,
+    so this touches far less memory than shifting everything down to keep them in order. Returns how many are left
+*/
+size_t compact(float* __restrict x, float* __restrict y, float* __restrict vx, float* __restrict vy, float* __restrict age,
+               float* __restrict life, pixel_t* __restrict color, size_t n)
+{
+    size_t i = 0;
+    while(i < n) {
+        if(age[i] < life[i]) {
+            i++;
+            continue;
+        }
+
+        //check the particle moved in here on the next pass (it could be dead too)
+        n--;
+        x[i] = x[n];
+        y[i] = y[n];
+        vx[i] = vx[n];
+        vy[i] = vy[n];
+        age[i] = age[n];
+        life[i] = life[n];
+        color[i] = color[n];
+    }
+
+    return n;
+}
+
+void Particles::update(float dt)
+{
+    for(Emitter& e : emitters) {
+        integrate(e.x.data(), e.y.data(), e.vx.data(), e.vy.data(), e.age.data(), e.count, e.gravityX * dt, e.gravityY * dt, dt);
+        e.count = compact(e.x.data(), e.y.data(), e.vx.data(), e.vy.data(), e.age.data(), e.life.data(), e.color.data(), e.count);
+    }
+}
+
+void Particles::draw(Emitter& e, int layer)
+{
+    screen.drawPoints(e.x.data(), e.y.data(), e.color.data(), e.count, e.size, layer);
+}
+
+void Particles::clear()
+{
+    emitters.clear();
+    freeEmitters.clear();
+}
+
+//xorshift32, returns a float in [0, 1)
+float randomUnit(uint32_t& seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed >> 8) * (1.0f / (1 << 24));
+}
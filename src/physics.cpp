@@ -1,10 +1,37 @@
 #include <cmath>
+#include <algorithm>
 
 #include "physics.hpp"
+#include "screen.hpp"
 
 using namespace Physics;
 
-void rotate_point(float& x, float& y, float cx, float cy, float r); //helper function for RotateRect
+//uniform grid of cells over the screen, each holding the objects whose box reaches into it
+typedef struct {
+    int cellSize;
+    int columns;
+    int rows;
+    std::vector<std::vector<BuiltIn::Object*>> cells;
+    std::vector<BuiltIn::Object*> moved; //objects that might not be in the right cells anymore
+    unsigned long long stamp;            //bumped for every query
+} Grid;
+
+//stretch of the x axis covered by the box of objs[index], for overlappingPairs
+typedef struct {
+    float minX;
+    float maxX;
+    int index;
+} Span;
+
+inline float reach(const BuiltIn::Transform& t, const float* axis);
+Grid& grid();
+std::vector<BuiltIn::Object*>& bodies();
+int cellColumn(Grid& g, float x);
+int cellRow(Grid& g, float y);
+void updateGrid(Grid& g);
+void removeFromCells(Grid& g, BuiltIn::Object* obj);
+
+std::vector<Span> sweepSpans; //kept between calls so sweeping every frame doesn't allocate
 
 //Vector2D class:
 Vector2D::Vector2D() {
@@ -42,15 +69,6 @@ point Vector2D::to_point() {
 }
 
 //Rect2D class:
-std::vector<Vector2D> Rect2D::get_points() {
-    std::vector<Vector2D> points;
-    points.push_back(top_right);
-    points.push_back(top_left);
-    points.push_back(bottom_left);
-    points.push_back(bottom_right);
-    return points;
-}
-
 void Physics::Rect2D::translateX(int amount) {
     top_right.x += amount;
     top_left.x += amount;
@@ -68,122 +86,308 @@ void Physics::Rect2D::translateY(int amount) {
 }
 
 /**
- * @brief Calculate the individual points of the physics bounding box of a Squiggly Object
+ * @brief Separating axis test between two boxes: they overlap unless there is a gap between them along one of their edge
+ * directions. Boxes that are far apart are rejected by their axis aligned boxes before any of that
  * 
- * @param obj 
- * @return Rect2D 
+ * @param one 
+ * @param two 
+ * @return true if the boxes overlap or touch
  */
-Rect2D Physics::ObjBoundingBox(BuiltIn::Object& obj) 
+bool Physics::BoxesOverlap(const BuiltIn::Transform& one, const BuiltIn::Transform& two)
 {
-    Rect2D box;
+    float dx = two.cx - one.cx;
+    float dy = two.cy - one.cy;
 
-    //temp variables to make code a little cleaner
-    int cx = obj.getX();
-    int cy = obj.getY();
-    int width = obj.getWidth() / 2;
-    int height = obj.getHeight() / 2;
-
-    int up = cy + height;
-    int down = cy - height;
-    int left = cx - width;
-    int right = cx + width;
+    //written so a box with NaN in it never overlaps anything
+    if(!(std::abs(dx) <= one.extentX + two.extentX && std::abs(dy) <= one.extentY + two.extentY))
+        return false;
 
-    //assigning values to bounding box struct
-    box.bottom_left.x = left;
-    box.bottom_left.y = down;
+    //boxes rotated by a multiple of 90 degrees are their own axis aligned boxes, so those overlap
+    bool oneAligned = one.sine == 0 || one.cosine == 0;
+    bool twoAligned = two.sine == 0 || two.cosine == 0;
+    if(oneAligned && twoAligned)
+        return true;
 
-    box.bottom_right.x = right;
-    box.bottom_right.y = down;
+    //edge directions of both boxes (width, then height)
+    const float axes[4][2] = {
+        {one.cosine, one.sine},
+        {-one.sine, one.cosine},
+        {two.cosine, two.sine},
+        {-two.sine, two.cosine},
+    };
+
+    for(const float* axis : axes) {
+        //distance between the centers, measured along the axis
+        float distance = std::abs(dx*axis[0] + dy*axis[1]);
+        if(distance > reach(one, axis) + reach(two, axis))
+            return false;
+    }
+
+    return true;
+}
 
-    box.top_left.x = left;
-    box.top_left.y = up;
-    
-    box.top_right.x = right;
-    box.top_right.y = up;
+/*
+    Separating axis test over time: along each axis the distance between the centers changes at a fixed rate while moving,
+    so the stretch of the move where the boxes overlap along that axis is worked out directly. The boxes touch where the
+    stretches of all four axes overlap, and the axis whose stretch starts last is the side that was hit.
 
-    box.center.x = cx;
-    box.center.y = cy;
+    Physics boxes sit on whole pixels (positions are rounded toward zero), so on the way the box can be up to a pixel off
+    from where the unrounded position says. It is swept from the middle of the pixel its position rounds into, grown by half
+    a pixel on every side to cover the whole pixel
+*/
+float Physics::TimeOfImpact(const BuiltIn::Transform& moving, float x, float y, float dx, float dy, const BuiltIn::Transform& wall, float& normalX, float& normalY)
+{
+    float startX = x >= 0 ? x - 0.5f : x + 0.5f;
+    float startY = y >= 0 ? y - 0.5f : y + 0.5f;
+
+    const float axes[4][2] = {
+        {moving.cosine, moving.sine},
+        {-moving.sine, moving.cosine},
+        {wall.cosine, wall.sine},
+        {-wall.sine, wall.cosine},
+    };
+
+    float enter = -INFINITY;
+    float exit = INFINITY;
+    normalX = 0;
+    normalY = 0;
+
+    for(const float* axis : axes) {
+        float distance = (wall.cx - startX)*axis[0] + (wall.cy - startY)*axis[1];
+        float speed = dx*axis[0] + dy*axis[1];
+        float r = reach(moving, axis) + reach(wall, axis) + (std::abs(axis[0]) + std::abs(axis[1])) / 2;
+
+        //written so NaN never overlaps
+        if(speed == 0) {
+            if(!(std::abs(distance) <= r))
+                return INFINITY;
+            continue;
+        }
+
+        float t0 = (distance - r) / speed;
+        float t1 = (distance + r) / speed;
+        if(t0 > t1)
+            std::swap(t0, t1);
+
+        if(t0 > enter) {
+            enter = t0;
+            normalX = speed > 0 ? -axis[0] : axis[0];
+            normalY = speed > 0 ? -axis[1] : axis[1];
+        }
+        exit = std::min(exit, t1);
+
+        if(!(enter <= exit) || enter > 1 || exit < 0)
+            return INFINITY;
+    }
+
+    if(enter <= 0) {
+        //already touching: only moves that end up clear of the wall are let through
+        if(BoxesOverlap(moving, wall)) {
+            normalX = 0;
+            normalY = 0;
+            return exit < 1 ? INFINITY : 0;
+        }
+
+        //only close enough that rounding could make it touch: stopped straight away unless it is heading away from the wall
+        //(or along it, give or take rounding errors)
+        return dx*normalX + dy*normalY < -0.001f ? 0 : INFINITY;
+    }
+
+    return enter;
+}
 
-    //rotate box
-    RotateRect(box, obj.getRotation());
+void Physics::overlappingPairs(const std::vector<BuiltIn::Object*>& objs, std::vector<std::pair<int, int>>& pairs)
+{
+    pairs.clear();
+    sweepSpans.clear();
+    for(size_t i=0; i<objs.size(); i++) {
+        //objects without a layer or mask can't collide with anything
+        if(!objs[i]->collisionLayer || !objs[i]->collisionMask)
+            continue;
+
+        const BuiltIn::Transform& t = objs[i]->getTransform();
+        Span s = {t.cx - t.extentX, t.cx + t.extentX, (int)i};
+
+        //a box with NaN in it can't be sorted (and doesn't touch anything)
+        if(s.minX <= s.maxX)
+            sweepSpans.push_back(s);
+    }
+
+    std::sort(sweepSpans.begin(), sweepSpans.end(), [](const Span& a, const Span& b) { return a.minX < b.minX; });
+
+    //every box starting before this one ends shares some of the x axis with it, the first one that starts after ends the run
+    for(size_t a=0; a<sweepSpans.size(); a++) {
+        BuiltIn::Object* one = objs[sweepSpans[a].index];
+        const BuiltIn::Transform& box = one->getTransform();
+
+        for(size_t b=a+1; b<sweepSpans.size() && sweepSpans[b].minX <= sweepSpans[a].maxX; b++) {
+            BuiltIn::Object* two = objs[sweepSpans[b].index];
+            if(one->collidesWith(*two) && BoxesOverlap(box, two->getTransform()))
+                pairs.push_back(std::minmax(sweepSpans[a].index, sweepSpans[b].index));
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
 
-    return box;
+//how far a box reaches from its center, measured along a unit length axis
+inline float reach(const BuiltIn::Transform& t, const float* axis)
+{
+    return t.halfW*std::abs(t.cosine*axis[0] + t.sine*axis[1]) + t.halfH*std::abs(t.cosine*axis[1] - t.sine*axis[0]);
 }
 
-bool Physics::PointInRect(point& p, Rect2D& rect)
+void Physics::setBody(BuiltIn::Object* obj, bool body)
 {
-    //get the points in the polygon and use barycentric weights to check if the point is in either polygon
-    point one = rect.bottom_left.to_point();
-    point two = rect.top_left.to_point();
-    point three = rect.top_right.to_point();
-    point four = rect.bottom_right.to_point();
+    if(obj->isBody == body)
+        return;
+
+    obj->isBody = body;
+    if(body)
+        bodies().push_back(obj);
+    else
+        bodies().erase(std::find(bodies().begin(), bodies().end(), obj));
+}
 
-    //thank you Jake Muzyka for the idea to use barycentric weights for collision detection
-    return PointInPollygon(one, two, three, p) || PointInPollygon(one, four, three, p);
+void Physics::step(float dt)
+{
+    for(BuiltIn::Object* obj : bodies())
+        obj->step(dt);
 }
 
-bool Physics::PointInRect(Vector2D& p, Rect2D& rect)
+void Physics::track(BuiltIn::Object* obj)
 {
-    point pt;
-    pt.x = p.x;
-    pt.y = p.y;
-    return PointInRect(pt, rect);
+    obj->tracked = true;
+    obj->gridCells[0] = -1;
+    obj->gridMoved = false;
+    obj->nearStamp = 0;
+    moved(obj);
 }
 
-bool Physics::PointInPollygon(point& one, point& two, point& three, point& p) 
+void Physics::untrack(BuiltIn::Object* obj)
 {
-    // Compute the area of the triangle (using the determinant)
-    float denom = (two.y - three.y) * (one.x - three.x) + (three.x - two.x) * (one.y - three.y);
+    setBody(obj, false);
 
-    //  No divide by 0 or very small triangles
-    if (std::abs(denom) < 1e-5f)
-        return false;
+    Grid& g = grid();
+    removeFromCells(g, obj);
 
-    float w0, w1, w2;
+    if(obj->gridMoved)
+        g.moved.erase(std::find(g.moved.begin(), g.moved.end(), obj));
+}
 
-    // Compute the barycentric weights
-    w0 = ((two.y - three.y) * (p.x - three.x) + (three.x - two.x) * (p.y - three.y)) / denom;
-    w1 = ((three.y - one.y) * (p.x - three.x) + (one.x - three.x) * (p.y - three.y)) / denom;
-    w2 = 1.0f - w0 - w1;
+void Physics::moved(BuiltIn::Object* obj)
+{
+    //nothing is worked out until the next query, an object can move many times in between
+    if(obj->tracked && !obj->gridMoved) {
+        obj->gridMoved = true;
+        grid().moved.push_back(obj);
+    }
+}
 
-    //  If weights are all valid, inside triangle
-    if(w0 >= 0 && w1 >= 0 && w2 >= 0)
-        return true;
+unsigned long long Physics::nearby(float minX, float minY, float maxX, float maxY)
+{
+    Grid& g = grid();
+    updateGrid(g);
+
+    g.stamp++;
+    int c0 = cellColumn(g, minX), c1 = cellColumn(g, maxX);
+    int r0 = cellRow(g, minY), r1 = cellRow(g, maxY);
+    for(int r=r0; r<=r1; r++) {
+        for(int c=c0; c<=c1; c++) {
+            for(BuiltIn::Object* obj : g.cells[r*g.columns + c])
+                obj->nearStamp = g.stamp;
+        }
+    }
+
+    return g.stamp;
+}
 
-    return false;
+/*
+    The grid is only made once (the resolution can't change while scripts run) and never freed, so objects destroyed while
+    the program exits can still take themselves out of it
+*/
+Grid& grid()
+{
+    static Grid* g = nullptr;
+    if(!g) {
+        g = new Grid();
+        g->cellSize = std::max(1, (std::max(screen.width, screen.height) + BROADPHASE_CELLS - 1) / BROADPHASE_CELLS);
+        g->columns = (screen.width + g->cellSize - 1) / g->cellSize;
+        g->rows = (screen.height + g->cellSize - 1) / g->cellSize;
+        g->cells.resize(g->columns * g->rows);
+        g->stamp = 0;
+    }
+
+    return *g;
 }
 
-/**
- * @brief Rotate the points in a rectangle rot degrees
- * 
- * @param rect 
- * @param rot 
- */
-void Physics::RotateRect(Rect2D& rect, float rot)
+//objects that are physics bodies. Never freed, for the same reason as the grid
+std::vector<BuiltIn::Object*>& bodies()
 {
-    rotate_point(rect.bottom_left.x, rect.bottom_left.y, rect.center.x, rect.center.y, rot);
-    rotate_point(rect.bottom_right.x, rect.bottom_right.y, rect.center.x, rect.center.y, rot);
-    rotate_point(rect.top_left.x, rect.top_left.y, rect.center.x, rect.center.y, rot);
-    rotate_point(rect.top_right.x, rect.top_right.y, rect.center.x, rect.center.y, rot);
+    static std::vector<BuiltIn::Object*>* list = new std::vector<BuiltIn::Object*>();
+    return *list;
 }
 
-//helper functions
-void rotate_point(float& x, float& y, float cx, float cy, float r) 
+//cell a coordinate falls in, clamped to the grid (written so NaN lands in the first cell)
+int cellColumn(Grid& g, float x)
 {
-    r = r * (3.1415926 / 180); //degrees to radians
-    
-    float s = sin(r);
-    float c = cos(r);
+    float c = floorf(x / g.cellSize);
+    if(!(c >= 0))
+        return 0;
+    return c < g.columns ? (int)c : g.columns - 1;
+}
 
-    // translate point back to origin:
-    x -= cx;
-    y -= cy;
+int cellRow(Grid& g, float y)
+{
+    float r = floorf(y / g.cellSize);
+    if(!(r >= 0))
+        return 0;
+    return r < g.rows ? (int)r : g.rows - 1;
+}
 
-    // rotate point
-    float xnew = x * c - y * s;
-    float ynew = x * s + y * c;
+/*
+    Put every object that might have moved since the last query back into the right cells. Objects that stayed within the
+    same cells (most of them, cells are much bigger than a frame's worth of movement) aren't touched
+*/
+void updateGrid(Grid& g)
+{
+    for(BuiltIn::Object* obj : g.moved) {
+        obj->gridMoved = false;
+
+        const BuiltIn::Transform& t = obj->getTransform();
+        int cells[4] = {
+            cellColumn(g, t.cx - t.extentX),
+            cellRow(g, t.cy - t.extentY),
+            cellColumn(g, t.cx + t.extentX),
+            cellRow(g, t.cy + t.extentY),
+        };
+
+        if(std::equal(cells, cells + 4, obj->gridCells))
+            continue;
+
+        removeFromCells(g, obj);
+        std::copy(cells, cells + 4, obj->gridCells);
+        for(int r=cells[1]; r<=cells[3]; r++) {
+            for(int c=cells[0]; c<=cells[2]; c++)
+                g.cells[r*g.columns + c].push_back(obj);
+        }
+    }
+
+    g.moved.clear();
+}
 
-    // translate point back:
-    x = xnew + cx;
-    y = ynew + cy;
-}
\ No newline at end of file
+void removeFromCells(Grid& g, BuiltIn::Object* obj)
+{
+    if(obj->gridCells[0] < 0)
+        return;
+
+    for(int r=obj->gridCells[1]; r<=obj->gridCells[3]; r++) {
+        for(int c=obj->gridCells[0]; c<=obj->gridCells[2]; c++) {
+            //order in a cell doesn't matter, move the last object into the gap
+            std::vector<BuiltIn::Object*>& cell = g.cells[r*g.columns + c];
+            *std::find(cell.begin(), cell.end(), obj) = cell.back();
+            cell.pop_back();
+        }
+    }
+
+    obj->gridCells[0] = -1;
+}
@@ -0,0 +1,224 @@
+/*
+    SIMD implementations of the screen buffer fill routines.
+
+    Every fill is turned into "repeat this 4 byte pattern over n bytes": a 32 bit pixel is its own pattern and a 16 bit (565)
+    pixel is just repeated twice. Each version broadcasts the pattern into a vector register and stores it as many times as it
+    fits, finishing off the last few bytes with the scalar loop.
+*/
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include "pixel-kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 true
+#else
+#define KERNELS_X86 false
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define KERNELS_NEON true
+#else
+#define KERNELS_NEON false
+#endif
+
+typedef void (*pattern_kernel)(uint8_t* dst, size_t bytes, uint32_t pattern);
+
+void fill_pattern_scalar(uint8_t* dst, size_t bytes, uint32_t pattern);
+void fill_pattern_resolve(uint8_t* dst, size_t bytes, uint32_t pattern);
+pattern_kernel select_kernel(const char*& name);
+pattern_kernel resolve_kernel();
+
+//starts out pointing at the resolver so the first fill picks the implementation (works even if other globals, like the screen, fill during static init).
+//Render workers can make that first fill at the same time, so the pointer is atomic and the pick itself only ever runs once
+const char* kernel_name = "scalar";
+std::atomic<pattern_kernel> pattern_impl(fill_pattern_resolve);
+std::once_flag kernel_picked;
+
+inline uint32_t pattern16(uint16_t value) {
+    return (uint32_t)value | ((uint32_t)value << 16);
+}
+
+void Kernels::fill_span(uint32_t* dst, size_t count, uint32_t value) 
+{
+    pattern_impl.load(std::memory_order_relaxed)((uint8_t*)dst, count*sizeof(uint32_t), value);
+}
+
+void Kernels::fill_span(uint16_t* dst, size_t count, uint16_t value) 
+{
+    pattern_impl.load(std::memory_order_relaxed)((uint8_t*)dst, count*sizeof(uint16_t), pattern16(value));
+}
+
+void Kernels::fill_rect(uint32_t* dst, size_t stride, size_t width, size_t height, uint32_t value) 
+{
+    if(stride == width) {
+        //rows are back to back, fill it as one long span
+        fill_span(dst, width*height, value);
+        return;
+    }
+
+    for(size_t y=0; y<height; y++)
+        fill_span(dst + y*stride, width, value);
+}
+
+void Kernels::fill_rect(uint16_t* dst, size_t stride, size_t width, size_t height, uint16_t value) 
+{
+    if(stride == width) {
+        fill_span(dst, width*height, value);
+        return;
+    }
+
+    for(size_t y=0; y<height; y++)
+        fill_span(dst + y*stride, width, value);
+}
+
+void Kernels::clear(uint32_t* dst, size_t count, uint32_t value) 
+{
+    uint8_t byte = value & 0xFF;
+    if(value == byte * 0x01010101u) {
+        memset(dst, byte, count*sizeof(uint32_t)); //every byte is the same, no need for a pattern at all
+        return;
+    }
+
+    fill_span(dst, count, value);
+}
+
+void Kernels::clear(uint16_t* dst, size_t count, uint16_t value) 
+{
+    uint8_t byte = value & 0xFF;
+    if(value == byte * 0x0101u) {
+        memset(dst, byte, count*sizeof(uint16_t));
+        return;
+    }
+
+    fill_span(dst, count, value);
+}
+
+const char* Kernels::implementation() 
+{
+    resolve_kernel();
+    return kernel_name;
+}
+
+//implementations: ----------------------------------------------------------------------------
+
+void fill_pattern_scalar(uint8_t* dst, size_t bytes, uint32_t pattern) 
+{
+    for(; bytes >= 4; bytes -= 4) {
+        memcpy(dst, &pattern, 4);
+        dst += 4;
+    }
+
+    memcpy(dst, &pattern, bytes); //leftover half of a 565 pixel pair
+}
+
+#if KERNELS_X86
+__attribute__((target("sse2")))
+void fill_pattern_sse2(uint8_t* dst, size_t bytes, uint32_t pattern) 
+{
+    __m128i v = _mm_set1_epi32((int)pattern);
+
+    for(; bytes >= 64; bytes -= 64) {
+        _mm_storeu_si128((__m128i*)(dst), v);
+        _mm_storeu_si128((__m128i*)(dst+16), v);
+        _mm_storeu_si128((__m128i*)(dst+32), v);
+        _mm_storeu_si128((__m128i*)(dst+48), v);
+        dst += 64;
+    }
+
+    for(; bytes >= 16; bytes -= 16) {
+        _mm_storeu_si128((__m128i*)(dst), v);
+        dst += 16;
+    }
+
+    fill_pattern_scalar(dst, bytes, pattern);
+}
+
+__attribute__((target("avx2")))
+void fill_pattern_avx2(uint8_t* dst, size_t bytes, uint32_t pattern) 
+{
+    __m256i v = _mm256_set1_epi32((int)pattern);
+
+    for(; bytes >= 128; bytes -= 128) {
+        _mm256_storeu_si256((__m256i*)(dst), v);
+        _mm256_storeu_si256((__m256i*)(dst+32), v);
+        _mm256_storeu_si256((__m256i*)(dst+64), v);
+        _mm256_storeu_si256((__m256i*)(dst+96), v);
+        dst += 128;
+    }
+
+    for(; bytes >= 32; bytes -= 32) {
+        _mm256_storeu_si256((__m256i*)(dst), v);
+        dst += 32;
+    }
+
+    fill_pattern_scalar(dst, bytes, pattern);
+}
+#endif
+
+#if KERNELS_NEON
+void fill_pattern_neon(uint8_t* dst, size_t bytes, uint32_t pattern) 
+{
+    uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(pattern));
+
+    for(; bytes >= 64; bytes -= 64) {
+        vst1q_u8(dst, v);
+        vst1q_u8(dst+16, v);
+        vst1q_u8(dst+32, v);
+        vst1q_u8(dst+48, v);
+        dst += 64;
+    }
+
+    for(; bytes >= 16; bytes -= 16) {
+        vst1q_u8(dst, v);
+        dst += 16;
+    }
+
+    fill_pattern_scalar(dst, bytes, pattern);
+}
+#endif
+
+void fill_pattern_resolve(uint8_t* dst, size_t bytes, uint32_t pattern) 
+{
+    resolve_kernel()(dst, bytes, pattern);
+}
+
+//pick the implementation the first time this is called, blocking any other thread that gets here meanwhile until it is picked
+pattern_kernel resolve_kernel() 
+{
+    std::call_once(kernel_picked, []() {
+        pattern_impl.store(select_kernel(kernel_name), std::memory_order_relaxed);
+    });
+    return pattern_impl.load(std::memory_order_relaxed);
+}
+
+/*
+    Check what the cpu supports and return the fastest fill routine for it.
+    x86 is checked at runtime, NEON is only used when the compiler was already told the target has it.
+*/
+pattern_kernel select_kernel(const char*& name) 
+{
+    #if KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return fill_pattern_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        name = "sse2";
+        return fill_pattern_sse2;
+    }
+    #endif
+
+    #if KERNELS_NEON
+    name = "neon";
+    return fill_pattern_neon;
+    #endif
+
+    name = "scalar";
+    return fill_pattern_scalar;
+}
@@ -0,0 +1,94 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "presenter.hpp"
+#include "frontend.hpp"
+#include "screen.hpp"
+#include "capture.hpp"
+
+void presentLoop();
+
+std::thread presentThread;
+std::mutex presenterLock;
+std::condition_variable presenterReady;
+bool frontendReady = false;
+std::exception_ptr presentError = nullptr; //first error thrown on the present thread, waiting to be picked up by checkErrors()
+
+void Presenter::start() 
+{
+    stop();
+
+    frontendReady = false;
+    presentError = nullptr;
+    screen.startPresenting();
+
+    presentThread = std::thread(presentLoop);
+
+    //wait for the frontend to come up so errors from init are thrown right here like they used to be
+    std::unique_lock<std::mutex> lock(presenterLock);
+    presenterReady.wait(lock, [] { return frontendReady; });
+
+    if(presentError) {
+        lock.unlock();
+        presentThread.join();
+        checkErrors();
+    }
+}
+
+void Presenter::stop() 
+{
+    screen.stopPresenting();
+
+    if(presentThread.joinable())
+        presentThread.join();
+}
+
+void Presenter::checkErrors() 
+{
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(presenterLock);
+        error = presentError;
+        presentError = nullptr;
+    }
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+void presentLoop() 
+{
+    try {
+        Frontend::init();
+    } catch(...) {
+        std::lock_guard<std::mutex> lock(presenterLock);
+        presentError = std::current_exception();
+        frontendReady = true;
+        presenterReady.notify_one();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(presenterLock);
+        frontendReady = true;
+    }
+    presenterReady.notify_one();
+
+    try {
+        while(screen.waitForFrame()) {
+            Frontend::drawScreen();
+            Capture::frame(screen.presentBuff); //only copies the frame, it is saved on the capture writer thread
+            screen.framePresented();
+        }
+    } catch(...) {
+        {
+            std::lock_guard<std::mutex> lock(presenterLock);
+            presentError = std::current_exception();
+        }
+        screen.stopPresenting(); //make sure the interpreter never waits on a frame that won't be presented
+    }
+
+    Frontend::cleanUp();
+}
@@ -2,6 +2,8 @@
 #include <memory>
 #include <chrono>
 #include <stdexcept>
+#include <climits>
+#include <algorithm>
 
 #include "runner.hpp"
 #include "built-in.hpp"
@@ -10,6 +12,11 @@
 #include "tokenizer.hpp"
 #include "utils.hpp"
 #include "frontend.hpp"
+#include "presenter.hpp"
+#include "shape-cache.hpp"
+#include "font.hpp"
+#include "particles.hpp"
+#include "physics.hpp"
 
 using namespace Runner;
 
@@ -27,6 +34,7 @@ void setBIVars();
 
 //values used for built in variables
 std::chrono::steady_clock::time_point lastLoopTime = std::chrono::steady_clock::now();
+float frameTime = 0; //seconds since the last frame (what $DTIME is set to)
 
 //useful functions
 void runProgram(std::vector<TOKENIZED_PTR>& tokens, std::vector<Utils::SVariable>& memory, size_t stackFrameIdx, bool clearStackWhenDone=true, size_t startIdx=0, size_t endIdx=0, bool isFunction=false); //general function for running blocks of code
@@ -67,8 +75,11 @@ void Runner::executeVars() {
     createVariable(bVars, FPS_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr((int)0));
     createVariable(bVars, DTIME_VAR_NAME, Utils::VarType::FLOAT, Utils::createSharedPtr((float)0.0));
 
-    createVariable(bVars, SCREEN_WIDTH_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr((int)SCREEN_WIDTH));
-    createVariable(bVars, SCREEN_HEIGHT_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr((int)SCREEN_HEIGHT));
+    createVariable(bVars, SCREEN_WIDTH_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr(screen.width));
+    createVariable(bVars, SCREEN_HEIGHT_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr(screen.height));
+
+    createVariable(bVars, SHAPE_CACHE_HITS_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr((int)0));
+    createVariable(bVars, SHAPE_CACHE_MISSES_VAR_NAME, Utils::VarType::INTEGER, Utils::createSharedPtr((int)0));
 
     //flags for built in functions to set
     createVariable(bVars, COLLISION_FLAG_VAR_NAME, Utils::VarType::BOOL, Utils::createSharedPtr(false));
@@ -97,6 +108,7 @@ bool runningProgram = false;
 void Runner::execute() 
 {
     flushMem();
+    Particles::clear(); //before START, which is where scripts usually make their emitters
 
     //reserve memory space
     sVars.reserve(MEM_RESERVE_SIZE);
@@ -104,26 +116,40 @@ void Runner::execute()
     executeVars();
     executeStart();
 
-    Frontend::init();
+    ShapeCache::clear(); //shapes (and hit/miss counts) from the last script don't carry over
+    Font::init();
+    Presenter::start(); //frontend is started (and drawn to) on its own thread
+    screen.clear(); //start from a blank screen (also makes sure the whole first frame is presented)
 
     runningProgram = true;
-    while(runningProgram) {
-        #if BUILD_FOR_RASPI
-        Frontend::updateReadings(); //need to manually pull values from USB Gamepad into memory
-        #endif
-
-        screen.clear(); //clear the current screen
-        setBIVars(); //set built in variables
-
-        executeUpdate();
-        Frontend::drawScreen();
-
-        if(Frontend::getExitBtn())
-            runningProgram = false;
+    try {
+        while(runningProgram) {
+            #if BUILD_FOR_RASPI
+            Frontend::updateReadings(); //need to manually pull values from USB Gamepad into memory
+            #endif
+
+            screen.newFrame(); //get a free buffer and clear whatever was drawn in it last
+            setBIVars(); //set built in variables
+
+            //particles and physics bodies move by the same time step scripts see in $DTIME, before :UPDATE: runs
+            Particles::update(frameTime);
+            Physics::step(frameTime);
+
+            executeUpdate();
+            screen.flush(); //rasterize everything drawn this frame
+            screen.present(); //present thread sends it to the display while the next frame runs
+            Presenter::checkErrors();
+
+            if(Frontend::getExitBtn())
+                runningProgram = false;
+        }
+    } catch(...) {
+        Presenter::stop(); //don't leave the present thread running when a script error ends the program
+        throw;
     }
 
     flushMem(); //avoid memory leaks
-    Frontend::cleanUp();
+    Presenter::stop();
 }
 
 Utils::SVariable* Runner::fetchVariable(std::string name, bool allowArrays) 
@@ -203,6 +229,12 @@ Utils::SVariable* Runner::fetchVariable(std::string name, bool allowArrays)
         if(tmp && tmp->type==Utils::VarType::OBJECT && memberName!="") {
             tmp = ((BuiltIn::Object*)tmp->ptr.get())->fetchVariable(memberName);
         }
+        else if(tmp && tmp->type==Utils::VarType::TEXT && memberName!="") {
+            tmp = ((BuiltIn::Text*)tmp->ptr.get())->fetchVariable(memberName);
+        }
+        else if(tmp && tmp->type==Utils::VarType::TILEMAP && memberName!="") {
+            tmp = ((BuiltIn::Tilemap*)tmp->ptr.get())->fetchVariable(memberName);
+        }
         
         return tmp;
     }
@@ -438,11 +470,16 @@ void runObjectFunction(std::string name, std::vector<std::string>& args, size_t&
 {
     Utils::SVariable* objectVar = fetchVariable(name.substr(0, dotLocation));
     if(objectVar) {
-        if(objectVar->type != Utils::VarType::OBJECT)
-            throwRunnerError("Cannot run '" + name + "' on a non object type!");
-
         std::string functionName = name.substr(dotLocation+1, name.length()-(dotLocation+1));
-        ((BuiltIn::Object*)objectVar->ptr.get())->callFunction(functionName, args);
+
+        if(objectVar->type == Utils::VarType::OBJECT)
+            ((BuiltIn::Object*)objectVar->ptr.get())->callFunction(functionName, args);
+        else if(objectVar->type == Utils::VarType::TEXT)
+            ((BuiltIn::Text*)objectVar->ptr.get())->callFunction(functionName, args);
+        else if(objectVar->type == Utils::VarType::TILEMAP)
+            ((BuiltIn::Tilemap*)objectVar->ptr.get())->callFunction(functionName, args);
+        else
+            throwRunnerError("Cannot run '" + name + "' on a non object type!");
     } else {
         throwRunnerError("Unable to execute function '" + name + "'");
     }
@@ -659,16 +696,31 @@ void setBIVars() {
                 Utils::createSharedPtr(dtime/1000),
                 Utils::VarType::FLOAT, "=");
 
+    frameTime = dtime/1000;
+
     temp = SCREEN_WIDTH_VAR_NAME;
     temp.insert(0, 1, BUILT_IN_VAR_PREFIX);
     setVariable(fetchVariable(temp)->ptr, 
-                Utils::createSharedPtr(SCREEN_WIDTH),
+                Utils::createSharedPtr(screen.width),
                 Utils::VarType::INTEGER, "=");
 
     temp = SCREEN_HEIGHT_VAR_NAME;
     temp.insert(0, 1, BUILT_IN_VAR_PREFIX);
     setVariable(fetchVariable(temp)->ptr, 
-                Utils::createSharedPtr(SCREEN_HEIGHT),
+                Utils::createSharedPtr(screen.height),
+                Utils::VarType::INTEGER, "=");
+
+    //rendering stats
+    temp = SHAPE_CACHE_HITS_VAR_NAME;
+    temp.insert(0, 1, BUILT_IN_VAR_PREFIX);
+    setVariable(fetchVariable(temp)->ptr, 
+                Utils::createSharedPtr((int)std::min(ShapeCache::hits(), (unsigned long long)INT_MAX)),
+                Utils::VarType::INTEGER, "=");
+
+    temp = SHAPE_CACHE_MISSES_VAR_NAME;
+    temp.insert(0, 1, BUILT_IN_VAR_PREFIX);
+    setVariable(fetchVariable(temp)->ptr, 
+                Utils::createSharedPtr((int)std::min(ShapeCache::misses(), (unsigned long long)INT_MAX)),
                 Utils::VarType::INTEGER, "=");
 }
 
@@ -1,53 +1,821 @@
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <new>
+
 #include "screen.hpp"
 #include "built-in.hpp"
 #include "graphics.hpp"
+#include "pixel-kernels.hpp"
+#include "workers.hpp"
+#include "assets.hpp"
+#include "shape-cache.hpp"
 
 Screen::Screen() {
-    clear();
+    layered = false;
+    staticLayered = false;
+    commands.reserve(DISPLAY_LIST_RESERVE);
+
+    framesSubmitted = 0;
+    framesPresented = 0;
+    presenting = -1;
+    stopped = true;
+
+    staticLayer = nullptr;
+    for(int i=0; i<SCREEN_BUFFERS; i++)
+        buffers[i] = nullptr;
+
+    setResolution(DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT);
+}
+
+Screen::~Screen() {
+    freeBuffers();
+}
+
+/*
+    Every buffer (and everything that was tracked about them) is thrown out and allocated again at the new size
+*/
+void Screen::setResolution(int w, int h) {
+    freeBuffers();
+
+    width = w;
+    height = h;
+
+    //aligned operator new rather than aligned_alloc, which MSVC doesn't have (throws bad_alloc on its own)
+    size_t bytes = (size_t)w*h*sizeof(pixel_t);
+
+    for(int i=0; i<SCREEN_BUFFERS; i++) {
+        buffers[i] = (pixel_t*)::operator new(bytes, std::align_val_t(FRAME_ALIGNMENT));
+
+        Kernels::clear(buffers[i], (size_t)w*h, packColor(0, 0, 0));
+        resetRows(drawnRows[i]);
+        resetRows(presentRows[i]);
+        bufferVersions[i] = 0;
+    }
+    markAll(lastDrawn); //nothing has been sent to the display yet, so the first frame has to be sent in full
+
+    staticLayer = (pixel_t*)::operator new(bytes, std::align_val_t(FRAME_ALIGNMENT));
+
+    background = packColor(0, 0, 0);
+    Kernels::clear(staticLayer, (size_t)w*h, background);
+    resetRows(staticRows);
+    resetRows(staticChange);
+    staticChanged = false;
+    staticVersion = 0;
+    lastStatic.clear();
+    lastStaticGlyphs.clear();
+
+    back = 0;
+    screenBuff = frame(buffers[0]);
+    presentBuff = frame(buffers[0]);
+    drawn = &drawnRows[0];
+}
+
+void Screen::freeBuffers() {
+    for(int i=0; i<SCREEN_BUFFERS; i++) {
+        ::operator delete(buffers[i], std::align_val_t(FRAME_ALIGNMENT));
+        buffers[i] = nullptr;
+    }
+
+    ::operator delete(staticLayer, std::align_val_t(FRAME_ALIGNMENT));
+    staticLayer = nullptr;
+}
+
+FrameView Screen::frame(pixel_t* pixels) {
+    FrameView view;
+    view.pixels = pixels;
+    view.stride = width;
+    return view;
 }
 
 void Screen::clear() {
-    for(size_t x=0; x<SCREEN_WIDTH; x++) {
-        for(size_t y=0; y<SCREEN_HEIGHT; y++) {
-            screenBuff[y][x][0] = 0; //r
-            screenBuff[y][x][1] = 0; //g
-            screenBuff[y][x][2] = 0; //b
+    clear(0, 0, 0);
+}
+
+void Screen::clear(uint8_t r, uint8_t g, uint8_t b) {
+    //the static layer is what every frame gets erased to, so it becomes this color with nothing on it
+    background = packColor(r, g, b);
+    Kernels::clear(staticLayer, (size_t)width*height, background);
+    resetRows(staticRows);
+    lastStatic.clear();
+    lastStaticGlyphs.clear();
+    staticVersion++; //every buffer gets erased in full the next time it is drawn to
+
+    Kernels::clear(screenBuff.pixels, (size_t)width*height, background);
+    markAll(lastDrawn); //and the whole screen presented, whatever the display was showing before
+}
+
+/*
+    Frame n is always drawn into buffer n % SCREEN_BUFFERS, which is free once frame n - SCREEN_BUFFERS has been presented.
+    The buffer still holds that old frame until flush() erases it.
+*/
+void Screen::newFrame() {
+    {
+        std::unique_lock<std::mutex> lock(frameLock);
+        bufferFree.wait(lock, [this] { return stopped || framesSubmitted - framesPresented < SCREEN_BUFFERS; });
+        back = framesSubmitted % SCREEN_BUFFERS;
+    }
+
+    screenBuff = frame(buffers[back]);
+    drawn = &drawnRows[back];
+
+    //a script error can leave a half built display list behind
+    commands.clear();
+    staticCommands.clear();
+    glyphs.clear();
+    staticGlyphs.clear();
+    points.clear();
+    tileWindows.clear();
+    tileCells.clear();
+    layered = false;
+    staticLayered = false;
+}
+
+/*
+    Frames are presented in order, so the display is showing the previous frame when this one gets to it. Only rows
+    drawn in either of them can be different.
+*/
+void Screen::present() {
+    DirtyRows& rows = presentRows[framesSubmitted % SCREEN_BUFFERS];
+    for(int y=0; y<height; y++) {
+        rows.minX[y] = std::min(drawn->minX[y], lastDrawn.minX[y]);
+        rows.maxX[y] = std::max(drawn->maxX[y], lastDrawn.maxX[y]);
+    }
+    lastDrawn = *drawn;
+
+    //if the static layer changed, so did everything it covers now or used to cover
+    if(staticChanged) {
+        for(int y=0; y<height; y++) {
+            rows.minX[y] = std::min(rows.minX[y], staticChange.minX[y]);
+            rows.maxX[y] = std::max(rows.maxX[y], staticChange.maxX[y]);
         }
+        staticChanged = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(frameLock);
+        framesSubmitted++;
     }
+    frameReady.notify_one();
 }
 
+bool Screen::waitForFrame() {
+    std::unique_lock<std::mutex> lock(frameLock);
+    frameReady.wait(lock, [this] { return stopped || framesPresented < framesSubmitted; });
+
+    if(stopped)
+        return false;
+
+    presenting = framesPresented % SCREEN_BUFFERS;
+    presentBuff = frame(buffers[presenting]);
+    return true;
+}
+
+void Screen::framePresented() {
+    {
+        std::lock_guard<std::mutex> lock(frameLock);
+        framesPresented++;
+        presenting = -1;
+    }
+    bufferFree.notify_one();
+}
+
+//only called while neither side is running, any frames dropped by the last stop are forgotten
+void Screen::startPresenting() {
+    std::lock_guard<std::mutex> lock(frameLock);
+    framesPresented = framesSubmitted;
+    presenting = -1;
+    stopped = false;
+}
+
+void Screen::stopPresenting() {
+    {
+        std::lock_guard<std::mutex> lock(frameLock);
+        stopped = true;
+    }
+    frameReady.notify_all();
+    bufferFree.notify_all();
+}
+
+void Screen::markDirty(int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width-1);
+    y1 = std::min(y1, height-1);
+
+    if(x0 > x1)
+        return;
+
+    for(int y=y0; y<=y1; y++)
+        markRow(y, x0, x1);
+}
+
+/*
+    Walk the rows that have to be sent for the frame being presented, grouping runs of consecutive changed rows into windows
+    (each window spans the widest damage of the rows in it)
+*/
+void Screen::forEachDirtyWindow(const std::function<void(const DirtyWindow&)>& sink) {
+    if(presenting < 0)
+        return;
+
+    const DirtyRows& rows = presentRows[presenting];
+    DirtyWindow window;
+    bool open = false;
+
+    for(int y=0; y<height; y++) {
+        int x0 = rows.minX[y];
+        int x1 = rows.maxX[y];
+
+        if(x0 > x1) {
+            //clean row, close the current window
+            if(open)
+                sink(window);
+            open = false;
+            continue;
+        }
+
+        if(!open) {
+            window.x0 = x0;
+            window.x1 = x1;
+            window.y0 = y;
+            open = true;
+        }
+
+        window.x0 = std::min(window.x0, x0);
+        window.x1 = std::max(window.x1, x1);
+        window.y1 = y;
+    }
+
+    if(open)
+        sink(window);
+}
+
+void Screen::resetRows(DirtyRows& rows) {
+    rows.minX.assign(height, width);
+    rows.maxX.assign(height, -1);
+}
+
+void Screen::markAll(DirtyRows& rows) {
+    rows.minX.assign(height, 0);
+    rows.maxX.assign(height, width-1);
+}
+
+/*
+    Record an object's shape in the display list
+*/
 void Screen::drawObj(BuiltIn::Object& obj)
 {
-    //extract object color and store in graphics color struct
-    SGraphics::Color objColor;
+    DrawCommand cmd;
+    cmd.type = DRAW_OBJ;
+    cmd.shape = obj.shape;
+    cmd.fill = obj.solid;
+    cmd.layer = obj.drawLayer;
 
     uint8_t c[3];
     obj.getColor(c);
+    cmd.r = c[0];
+    cmd.g = c[1];
+    cmd.b = c[2];
+
+    //placement (and the box drawing can touch) only changes when the object does
+    const BuiltIn::Transform& t = obj.getTransform();
+    cmd.x = t.cx;
+    cmd.y = t.cy;
+    cmd.x2 = t.width;
+    cmd.y2 = t.height;
+    cmd.rot = t.rotation;
+    cmd.sine = t.sine;
+    cmd.cosine = t.cosine;
+    cmd.image = obj.image;
+
+    if(cmd.shape == BuiltIn::ObjectShape::IMAGE) {
+        //images are drawn at their own size and aren't rotated (same placement as SGraphics::draw_image)
+        const Assets::Image& img = Assets::get(cmd.image);
+        cmd.minX = cmd.x - img.width/2;
+        cmd.minY = cmd.y - img.height/2;
+        cmd.maxX = cmd.minX + img.width - 1;
+        cmd.maxY = cmd.minY + img.height - 1;
+    }
+    else {
+        cmd.minX = t.minX;
+        cmd.minY = t.minY;
+        cmd.maxX = t.maxX;
+        cmd.maxY = t.maxY;
+    }
+
+    queue(cmd, obj.isStatic);
+}
+
+/*
+    Record a filled, unrotated shape that isn't backed by an object (batched draws). Same placement and bounding box as
+    drawObj gives an object of this size
+*/
+void Screen::drawShape(BuiltIn::ObjectShape shape, int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b)
+{
+    if(w <= 0 || h <= 0)
+        return;
+
+    DrawCommand cmd;
+    cmd.type = DRAW_OBJ;
+    cmd.shape = shape;
+    cmd.fill = true;
+    cmd.image = -1;
+    cmd.layer = 0;
+    cmd.r = r;
+    cmd.g = g;
+    cmd.b = b;
+
+    cmd.x = x;
+    cmd.y = y;
+    cmd.x2 = w;
+    cmd.y2 = h;
+    cmd.rot = 0;
+    cmd.sine = 0;
+    cmd.cosine = 1;
+
+    cmd.minX = x - (w/2 + 1);
+    cmd.maxX = x + (w/2 + 1);
+    cmd.minY = y - (h/2 + 1);
+    cmd.maxY = y + (h/2 + 1);
+
+    queue(cmd, false);
+}
+
+/*
+    Record a line in the display list
+*/
+void Screen::drawLine(int x1, int y1, int x2, int y2, uint8_t r, uint8_t g, uint8_t b)
+{
+    DrawCommand cmd;
+    cmd.type = DRAW_LINE;
+    cmd.shape = 0;
+    cmd.fill = false;
+    cmd.image = -1;
+    cmd.layer = 0;
+    cmd.r = r;
+    cmd.g = g;
+    cmd.b = b;
+
+    cmd.x = x1;
+    cmd.y = y1;
+    cmd.x2 = x2;
+    cmd.y2 = y2;
+    cmd.rot = 0;
+    cmd.sine = 0;
+    cmd.cosine = 1;
+
+    cmd.minX = std::min(x1, x2);
+    cmd.maxX = std::max(x1, x2);
+    cmd.minY = std::min(y1, y2);
+    cmd.maxY = std::max(y1, y2);
+
+    queue(cmd, false);
+}
+
+/*
+    Record a text variable in the display list. Its glyphs are copied into the list's glyph buffer, so the text can
+    change after this without changing what gets drawn
+*/
+void Screen::drawText(BuiltIn::Text& text)
+{
+    int textWidth, textHeight;
+    const std::vector<Font::Placement>& textGlyphs = text.getGlyphs(textWidth, textHeight);
+    if(textGlyphs.empty())
+        return;
+
+    DrawCommand cmd;
+    cmd.type = DRAW_TEXT;
+    cmd.shape = 0;
+    cmd.fill = true;
+    cmd.layer = text.drawLayer;
+
+    uint8_t c[3];
+    text.getColor(c);
+    cmd.r = c[0];
+    cmd.g = c[1];
+    cmd.b = c[2];
+
+    cmd.x = text.getX();
+    cmd.y = text.getY();
+    cmd.x2 = textGlyphs.size();
+    cmd.y2 = std::clamp(text.scale, 1, MAX_TEXT_SCALE);
+    cmd.rot = 0;
+    cmd.sine = 0;
+    cmd.cosine = 1;
+
+    cmd.minX = cmd.x;
+    cmd.minY = cmd.y;
+    cmd.maxX = cmd.x + textWidth*cmd.y2 - 1;
+    cmd.maxY = cmd.y + textHeight*cmd.y2 - 1;
+
+    std::vector<Font::Placement>& listGlyphs = text.isStatic ? staticGlyphs : glyphs;
+    cmd.image = listGlyphs.size();
+    if(queue(cmd, text.isStatic))
+        listGlyphs.insert(listGlyphs.end(), textGlyphs.begin(), textGlyphs.end());
+}
+
+/*
+    Record a batch of points (an emitter's particles) in the display list. Positions are the centers of the squares and
+    are copied into the frame's point buffer, anything entirely off screen is dropped here
+*/
+void Screen::drawPoints(const float* xs, const float* ys, const pixel_t* colors, size_t count, int size, int layer)
+{
+    size_t first = points.size();
+    points.resize(first + count);
+    DrawPoint* out = points.data() + first;
+
+    //local copies, writing the points could otherwise be reloading these every time through the loop
+    const int w = width;
+    const int h = height;
+
+    int half = size/2;
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    size_t kept = 0;
 
-    objColor.r = c[0];
-    objColor.g = c[1];
-    objColor.b = c[2];
+    for(size_t i=0; i<count; i++) {
+        //compare as floats first, so particles far off screen (or broken ones) are never converted to int
+        if(!(xs[i] > -size && ys[i] > -size && xs[i] < w + size && ys[i] < h + size))
+            continue;
 
-    //extract object position
-    SGraphics::pixel objLoc;
+        int x = (int)xs[i] - half;
+        int y = (int)ys[i] - half;
+        if(x >= w || y >= h || x + size <= 0 || y + size <= 0)
+            continue;
 
-    objLoc.x = obj.getX();
-    objLoc.y = obj.getY();
+        out[kept].x = x;
+        out[kept].y = y;
+        out[kept].color = colors[i];
+        kept++;
 
-    switch(obj.shape) {
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+    points.resize(first + kept);
+
+    if(kept == 0)
+        return;
+
+    DrawCommand cmd;
+    cmd.type = DRAW_POINTS;
+    cmd.shape = 0;
+    cmd.fill = true;
+    cmd.image = first;
+    cmd.layer = layer;
+    cmd.r = 0;
+    cmd.g = 0;
+    cmd.b = 0;
+
+    cmd.x = 0;
+    cmd.y = 0;
+    cmd.x2 = kept;
+    cmd.y2 = size;
+    cmd.rot = 0;
+    cmd.sine = 0;
+    cmd.cosine = 1;
+
+    cmd.minX = minX;
+    cmd.minY = minY;
+    cmd.maxX = maxX + size - 1;
+    cmd.maxY = maxY + size - 1;
+
+    queue(cmd, false);
+}
+
+//floor(a / b) for b > 0
+int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/*
+    Record the part of a tilemap that is on screen. Only the visible cells are copied, so drawing a map costs the same
+    however big the level is
+*/
+void Screen::drawTilemap(BuiltIn::Tilemap& map)
+{
+    if(map.tileset < 0 || map.columns == 0 || map.rows == 0)
+        return;
+
+    //screen position of the map's top left corner (whole pixels, so tiles line up with each other)
+    float scrollX = map.getScrollX();
+    float scrollY = map.getScrollY();
+    if(!(fabs(scrollX) < INT_MAX/2 && fabs(scrollY) < INT_MAX/2))
+        return;
+
+    int originX = -(int)floor(scrollX);
+    int originY = -(int)floor(scrollY);
+    int s = map.tileSize;
+
+    int c0 = std::max(floorDiv(-originX, s), 0);
+    int r0 = std::max(floorDiv(-originY, s), 0);
+    int c1 = std::min(floorDiv(width - 1 - originX, s), map.columns - 1);
+    int r1 = std::min(floorDiv(height - 1 - originY, s), map.rows - 1);
+    if(c0 > c1 || r0 > r1)
+        return;
+
+    TileWindow window;
+    window.image = map.tileset;
+    window.tileSize = s;
+    window.columns = c1 - c0 + 1;
+    window.rows = r1 - r0 + 1;
+    window.firstCell = tileCells.size();
+
+    for(int r=r0; r<=r1; r++) {
+        const uint16_t* row = &map.cells[(size_t)r*map.columns];
+        tileCells.insert(tileCells.end(), row + c0, row + c1 + 1);
+    }
+
+    DrawCommand cmd;
+    cmd.type = DRAW_TILES;
+    cmd.shape = 0;
+    cmd.fill = true;
+    cmd.image = tileWindows.size();
+    cmd.layer = map.drawLayer;
+    cmd.r = 0;
+    cmd.g = 0;
+    cmd.b = 0;
+
+    cmd.x = originX + c0*s;
+    cmd.y = originY + r0*s;
+    cmd.x2 = window.columns;
+    cmd.y2 = window.rows;
+    cmd.rot = 0;
+    cmd.sine = 0;
+    cmd.cosine = 1;
+
+    cmd.minX = cmd.x;
+    cmd.minY = cmd.y;
+    cmd.maxX = cmd.x + window.columns*s - 1;
+    cmd.maxY = cmd.y + window.rows*s - 1;
+
+    tileWindows.push_back(window);
+    queue(cmd, false);
+}
+
+bool Screen::queue(DrawCommand& cmd, bool isStatic)
+{
+    //anything entirely off screen never makes it into the list
+    if(cmd.maxX < 0 || cmd.maxY < 0 || cmd.minX >= width || cmd.minY >= height)
+        return false;
+
+    if(isStatic) {
+        staticLayered |= cmd.layer != 0;
+        staticCommands.push_back(cmd);
+        return true;
+    }
+
+    if(cmd.layer != 0)
+        layered = true;
+
+    commands.push_back(cmd);
+    return true;
+}
+
+/*
+    Finish the frame: bring the static layer up to date, erase the buffer back to it and draw everything else on top.
+    For a scene that is mostly static objects this is a copy of the rows the moving objects covered plus drawing them.
+*/
+void Screen::flush()
+{
+    ShapeCache::newFrame();
+
+    updateStaticLayer();
+    restoreFrame();
+    render(commands, glyphs, layered);
+
+    commands.clear();
+    glyphs.clear();
+    points.clear();
+    tileWindows.clear();
+    tileCells.clear();
+    layered = false;
+}
+
+//same draw with the same values (bounding box and cache slot follow from these, text is compared by the caller)
+bool sameCommand(const DrawCommand& a, const DrawCommand& b)
+{
+    return a.type == b.type && a.shape == b.shape && a.fill == b.fill && a.image == b.image && a.layer == b.layer &&
+           a.r == b.r && a.g == b.g && a.b == b.b && a.x == b.x && a.y == b.y && a.x2 == b.x2 && a.y2 == b.y2 && a.rot == b.rot;
+}
+
+/*
+    Static objects are drawn every frame like anything else, but the static layer only has to be redrawn when their
+    list of draws is different from the one it was drawn from
+*/
+void Screen::updateStaticLayer()
+{
+    bool same = staticCommands.size() == lastStatic.size() &&
+                std::equal(staticCommands.begin(), staticCommands.end(), lastStatic.begin(), sameCommand) &&
+                staticGlyphs.size() == lastStaticGlyphs.size() &&
+                std::equal(staticGlyphs.begin(), staticGlyphs.end(), lastStaticGlyphs.begin(), [](const Font::Placement& a, const Font::Placement& b) {
+                    return a.glyph == b.glyph && a.x == b.x && a.y == b.y;
+                });
+
+    staticGlyphs.swap(lastStaticGlyphs);
+    staticGlyphs.clear();
+
+    if(same) {
+        staticCommands.clear();
+        staticLayered = false;
+        return;
+    }
+
+    //everything the old static draws covered goes back to the background color
+    FrameView layer = frame(staticLayer);
+    for(int y=0; y<height; y++) {
+        if(staticRows.minX[y] <= staticRows.maxX[y])
+            Kernels::fill_span(&layer[y][staticRows.minX[y]], staticRows.maxX[y]-staticRows.minX[y]+1, background);
+    }
+    staticChange = staticRows;
+    resetRows(staticRows);
+
+    //draw through the same path as everything else, just pointed at the static layer
+    FrameView frameBuff = screenBuff;
+    DirtyRows* frameRows = drawn;
+    screenBuff = layer;
+    drawn = &staticRows;
+
+    render(staticCommands, lastStaticGlyphs, staticLayered);
+
+    screenBuff = frameBuff;
+    drawn = frameRows;
+
+    for(int y=0; y<height; y++) {
+        staticChange.minX[y] = std::min(staticChange.minX[y], staticRows.minX[y]);
+        staticChange.maxX[y] = std::max(staticChange.maxX[y], staticRows.maxX[y]);
+    }
+    staticChanged = true;
+    staticVersion++;
+
+    lastStatic.swap(staticCommands);
+    staticCommands.clear();
+    staticLayered = false;
+}
+
+/*
+    Erase the buffer being drawn back to the static layer. Only the rows drawn over it the last time the buffer was used
+    are different, unless the static layer changed since then (then the whole layer gets copied)
+*/
+void Screen::restoreFrame()
+{
+    if(bufferVersions[back] != staticVersion) {
+        memcpy(screenBuff.pixels, staticLayer, (size_t)width*height*sizeof(pixel_t));
+        bufferVersions[back] = staticVersion;
+    }
+    else {
+        FrameView layer = frame(staticLayer);
+        for(int y=0; y<height; y++) {
+            if(drawn->minX[y] <= drawn->maxX[y])
+                memcpy(&screenBuff[y][drawn->minX[y]], &layer[y][drawn->minX[y]], (drawn->maxX[y]-drawn->minX[y]+1) * sizeof(pixel_t));
+        }
+    }
+
+    resetRows(*drawn);
+}
+
+/*
+    Rasterize a display list into screenBuff.
+
+    Commands are sorted by layer (keeping the order they were drawn in within a layer), then walked from the top down
+    to find commands that are completely hidden under a later solid, unrotated rectangle (backgrounds, walls, etc). Everything
+    still visible is drawn from the bottom up.
+*/
+void Screen::render(std::vector<DrawCommand>& list, const std::vector<Font::Placement>& listGlyphs, bool sortLayers)
+{
+    if(sortLayers) {
+        std::stable_sort(list.begin(), list.end(), [](const DrawCommand& a, const DrawCommand& b) {
+            return a.layer < b.layer;
+        });
+    }
+
+    //occlusion pass: keep a small list of the opaque rectangles seen so far (going from the top down)
+    const size_t maxOccluders = 16;
+    int occluders[maxOccluders][4];
+    size_t numOccluders = 0;
+
+    visible.assign(list.size(), true);
+
+    for(size_t i=list.size(); i-- > 0;) {
+        DrawCommand& cmd = list[i];
+
+        for(size_t j=0; j<numOccluders; j++) {
+            if(cmd.minX >= occluders[j][0] && cmd.minY >= occluders[j][1] && cmd.maxX <= occluders[j][2] && cmd.maxY <= occluders[j][3]) {
+                visible[i] = false;
+                break;
+            }
+        }
+
+        //shapes are looked up here, on one thread, so workers only ever read from the cache
+        cmd.mask = visible[i] ? ShapeCache::lookup(cmd) : -1;
+
+        bool opaqueRect = cmd.type == DRAW_OBJ && cmd.shape == BuiltIn::ObjectShape::RECT && cmd.fill && cmd.sine == 0 && cmd.cosine == 1;
+        if(visible[i] && opaqueRect && numOccluders < maxOccluders) {
+            //exact pixels covered by an unrotated rect (same math as SGraphics::draw_rect)
+            occluders[numOccluders][0] = cmd.x - cmd.x2/2;
+            occluders[numOccluders][1] = cmd.y - cmd.y2/2;
+            occluders[numOccluders][2] = cmd.x + cmd.x2/2;
+            occluders[numOccluders][3] = cmd.y + cmd.y2/2;
+            numOccluders++;
+        }
+    }
+
+    if(Workers::count() == 1 || list.size() < 2) {
+        SGraphics::reset_clip();
+        for(size_t i=0; i<list.size(); i++) {
+            if(visible[i])
+                rasterize(list[i], listGlyphs);
+        }
+    }
+    else {
+        //bin commands into horizontal tiles. Each tile is drawn by one worker with drawing clipped to its rows, in the same order as
+        //the display list, so the result is exactly the same as drawing everything on one thread
+        size_t numTiles = (height + RENDER_TILE_ROWS - 1) / RENDER_TILE_ROWS;
+        tiles.resize(numTiles);
+        for(std::vector<size_t>& tile : tiles)
+            tile.clear();
+
+        for(size_t i=0; i<list.size(); i++) {
+            if(!visible[i])
+                continue;
+
+            int first = std::max(list[i].minY, 0) / RENDER_TILE_ROWS;
+            int last = std::min(list[i].maxY, height-1) / RENDER_TILE_ROWS;
+            for(int t=first; t<=last; t++)
+                tiles[t].push_back(i);
+        }
+
+        Workers::run(numTiles, [this, &list, &listGlyphs](size_t t) {
+            int top = t * RENDER_TILE_ROWS;
+            SGraphics::set_clip(0, top, width-1, top + RENDER_TILE_ROWS - 1);
+
+            for(size_t i : tiles[t])
+                rasterize(list[i], listGlyphs);
+
+            SGraphics::reset_clip();
+        });
+    }
+}
+
+void Screen::rasterize(DrawCommand& cmd, const std::vector<Font::Placement>& listGlyphs)
+{
+    SGraphics::Color color;
+    color.r = cmd.r;
+    color.g = cmd.g;
+    color.b = cmd.b;
+
+    SGraphics::pixel loc;
+    loc.x = cmd.x;
+    loc.y = cmd.y;
+
+    if(cmd.type == DRAW_LINE) {
+        SGraphics::pixel end;
+        end.x = cmd.x2;
+        end.y = cmd.y2;
+        SGraphics::draw_line(loc, end, color);
+        return;
+    }
+
+    if(cmd.type == DRAW_TEXT) {
+        SGraphics::draw_text(loc, &listGlyphs[cmd.image], cmd.x2, cmd.y2, color);
+        return;
+    }
+
+    if(cmd.type == DRAW_POINTS) {
+        SGraphics::draw_points(&points[cmd.image], cmd.x2, cmd.y2);
+        return;
+    }
+
+    if(cmd.type == DRAW_TILES) {
+        const TileWindow& window = tileWindows[cmd.image];
+        SGraphics::draw_tiles(loc, window, &tileCells[window.firstCell]);
+        return;
+    }
+
+    if(cmd.mask >= 0) {
+        SGraphics::draw_spans(loc, ShapeCache::spans(cmd.mask), color);
+        return;
+    }
+
+    switch(cmd.shape) {
         case BuiltIn::ObjectShape::RECT:
-            SGraphics::draw_rect(objLoc, obj.getWidth(), obj.getHeight(), obj.getRotation(), objColor, obj.solid);
+            SGraphics::draw_rect(loc, cmd.x2, cmd.y2, {cmd.sine, cmd.cosine}, color, cmd.fill);
             break;
 
         case BuiltIn::ObjectShape::ELLIPSE:
-            SGraphics::draw_ellipse(objLoc, obj.getWidth(), obj.getHeight(), obj.getRotation(), objColor, obj.solid);
+            SGraphics::draw_ellipse(loc, cmd.x2, cmd.y2, cmd.rot, color, cmd.fill);
             break;
 
         case BuiltIn::ObjectShape::TRIANGLE:
-            SGraphics::draw_triangle(objLoc, obj.getWidth(), obj.getHeight(), obj.getRotation(), objColor, obj.solid);
+            SGraphics::draw_triangle(loc, cmd.x2, cmd.y2, {cmd.sine, cmd.cosine}, color, cmd.fill);
+            break;
+
+        case BuiltIn::ObjectShape::IMAGE:
+            SGraphics::draw_image(loc, cmd.image);
             break;
     }
 }
 
 //initialize external variable
-Screen screen = Screen();
\ No newline at end of file
+Screen screen;
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include "shape-cache.hpp"
+#include "built-in.hpp"
+
+//one cached shape. Entries are kept in a list from most to least recently used
+typedef struct {
+    uint64_t key;
+    std::vector<SGraphics::span> spans;
+    unsigned long long lastUsed; //frame the entry was last looked up in
+    int prev;
+    int next;
+} CacheEntry;
+
+void unlinkEntry(int slot);
+void pushFrontEntry(int slot);
+bool evictOldestEntry();
+
+CacheEntry cacheEntries[SHAPE_CACHE_ENTRIES];
+std::unordered_map<uint64_t, int> cacheSlots; //key -> index in cacheEntries
+std::vector<int> freeSlots;
+int usedSlots = 0; //slots handed out at least once since the last clear
+int newest = -1;
+int oldest = -1;
+size_t totalSpans = 0;
+
+unsigned long long cacheFrame = 0;
+unsigned long long hitCount = 0;
+unsigned long long missCount = 0;
+
+int ShapeCache::lookup(const DrawCommand& cmd)
+{
+    if(cmd.type != DRAW_OBJ || cmd.shape == BuiltIn::ObjectShape::IMAGE)
+        return -1;
+    if(cmd.x2 < 0 || cmd.y2 < 0 || cmd.x2 > SHAPE_CACHE_MAX_SIZE || cmd.y2 > SHAPE_CACHE_MAX_SIZE)
+        return -1;
+
+    //unrotated solid rectangles are already a single block fill
+    if(cmd.shape == BuiltIn::ObjectShape::RECT && cmd.fill && cmd.sine == 0 && cmd.cosine == 1)
+        return -1;
+
+    double turn = fmod(cmd.rot, 360);
+    if(turn < 0)
+        turn += 360;
+    uint64_t step = (uint64_t)lround(turn * SHAPE_CACHE_ROT_STEPS / 360) % SHAPE_CACHE_ROT_STEPS;
+
+    uint64_t key = (uint64_t)cmd.x2 | ((uint64_t)cmd.y2 << 16) | (step << 32) | ((uint64_t)cmd.fill << 48) | ((uint64_t)cmd.shape << 49);
+
+    auto found = cacheSlots.find(key);
+    if(found != cacheSlots.end()) {
+        int slot = found->second;
+        unlinkEntry(slot);
+        pushFrontEntry(slot);
+        cacheEntries[slot].lastUsed = cacheFrame;
+        hitCount++;
+        return slot;
+    }
+
+    missCount++;
+
+    int slot;
+    if(freeSlots.empty() && usedSlots < SHAPE_CACHE_ENTRIES)
+        slot = usedSlots++;
+    else if(!freeSlots.empty() || evictOldestEntry()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+        return -1; //everything in the cache is in use this frame
+
+    CacheEntry& entry = cacheEntries[slot];
+    entry.key = key;
+    entry.lastUsed = cacheFrame;
+
+    //record the shape at the rounded rotation (color doesn't matter, only which pixels get filled)
+    float rot = (float)(step * 360.0 / SHAPE_CACHE_ROT_STEPS);
+    SGraphics::Color color = {0, 0, 0};
+    SGraphics::record_spans(entry.spans, [&](SGraphics::pixel loc) {
+        switch(cmd.shape) {
+            case BuiltIn::ObjectShape::RECT:
+                SGraphics::draw_rect(loc, cmd.x2, cmd.y2, SGraphics::make_rotation(rot), color, cmd.fill);
+                break;
+
+            case BuiltIn::ObjectShape::ELLIPSE:
+                SGraphics::draw_ellipse(loc, cmd.x2, cmd.y2, rot, color, cmd.fill);
+                break;
+
+            case BuiltIn::ObjectShape::TRIANGLE:
+                SGraphics::draw_triangle(loc, cmd.x2, cmd.y2, SGraphics::make_rotation(rot), color, cmd.fill);
+                break;
+        }
+    });
+
+    cacheSlots[key] = slot;
+    pushFrontEntry(slot);
+    totalSpans += entry.spans.size();
+
+    //stay inside the span budget (shapes used this frame are kept until the next one)
+    while(totalSpans > SHAPE_CACHE_MAX_SPANS && oldest != slot && evictOldestEntry());
+
+    return slot;
+}
+
+const std::vector<SGraphics::span>& ShapeCache::spans(int slot)
+{
+    return cacheEntries[slot].spans;
+}
+
+void ShapeCache::newFrame()
+{
+    cacheFrame++;
+
+    while(totalSpans > SHAPE_CACHE_MAX_SPANS && evictOldestEntry());
+}
+
+void ShapeCache::clear()
+{
+    cacheSlots.clear();
+    freeSlots.clear();
+    for(int i=0; i<usedSlots; i++)
+        cacheEntries[i].spans.clear();
+    usedSlots = 0;
+
+    newest = -1;
+    oldest = -1;
+    totalSpans = 0;
+    hitCount = 0;
+    missCount = 0;
+}
+
+unsigned long long ShapeCache::hits()
+{
+    return hitCount;
+}
+
+unsigned long long ShapeCache::misses()
+{
+    return missCount;
+}
+
+//throw out the least recently used entry, unless it was used this cacheFrame (commands may still be pointing at it)
+bool evictOldestEntry()
+{
+    if(oldest < 0 || cacheEntries[oldest].lastUsed == cacheFrame)
+        return false;
+
+    int slot = oldest;
+    unlinkEntry(slot);
+    cacheSlots.erase(cacheEntries[slot].key);
+    totalSpans -= cacheEntries[slot].spans.size();
+    cacheEntries[slot].spans.clear();
+    freeSlots.push_back(slot);
+    return true;
+}
+
+void unlinkEntry(int slot)
+{
+    CacheEntry& e = cacheEntries[slot];
+    if(e.prev >= 0)
+        cacheEntries[e.prev].next = e.next;
+    else
+        newest = e.next;
+
+    if(e.next >= 0)
+        cacheEntries[e.next].prev = e.prev;
+    else
+        oldest = e.prev;
+}
+
+void pushFrontEntry(int slot)
+{
+    cacheEntries[slot].prev = -1;
+    cacheEntries[slot].next = newest;
+    if(newest >= 0)
+        cacheEntries[newest].prev = slot;
+    newest = slot;
+
+    if(oldest < 0)
+        oldest = slot;
+}
@@ -35,6 +35,8 @@ std::string Utils::varTypeToString(VarType& type) {
             return "OBJECT";
         case VarType::TEXT:
             return "TEXT";
+        case VarType::TILEMAP:
+            return "TILEMAP";
     }
 
     return "invalid";
@@ -55,6 +57,8 @@ VarType Utils::stringToVarType(std::string& str) {
         return VarType::OBJECT;
     else if(str=="TEXT")
         return VarType::TEXT;
+    else if(str=="TILEMAP")
+        return VarType::TILEMAP;
 
     return VarType::NONE;
 }
@@ -123,7 +127,7 @@ SVariable Utils::convertToVariable(std::string input, VarType expectedType) {
     tmp.name = "tmp"; //main code has to set this manually
     tmp.type = VarType::NONE;
 
-    if(expectedType == VarType::OBJECT || expectedType == VarType::TEXT) {
+    if(expectedType == VarType::OBJECT || expectedType == VarType::TEXT || expectedType == VarType::TILEMAP) {
         SVariable* var = Runner::fetchVariable(input);
         if(var) {
             tmp.type = var->type;
@@ -193,7 +197,9 @@ std::shared_ptr<void> Utils::createEmptyShared(VarType type) {
         case VarType::DOUBLE: return createSharedPtr((double)0);
         case VarType::FLOAT: return createSharedPtr((float)0);
         case VarType::BOOL: return createSharedPtr(false);
-        case VarType::OBJECT: return std::make_shared<BuiltIn::Object>(BuiltIn::Object());
+        case VarType::OBJECT: return std::make_shared<BuiltIn::Object>();
+        case VarType::TEXT: return std::make_shared<BuiltIn::Text>(BuiltIn::Text());
+        case VarType::TILEMAP: return std::make_shared<BuiltIn::Tilemap>(BuiltIn::Tilemap());
         default: return createSharedPtr((int)0);
     }
 }
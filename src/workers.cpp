@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+#include "workers.hpp"
+
+//the most threads the pool will start on its own (more than this doesn't help with screens this size)
+#define MAX_DEFAULT_WORKERS 8
+
+void workerLoop();
+void drainJobs();
+
+std::vector<std::thread> threads;
+std::mutex poolLock;
+std::condition_variable wakeWorkers;
+std::condition_variable batchDone;
+
+//current batch of jobs (only changed while holding poolLock)
+const std::function<void(size_t)>* currentJob = nullptr;
+size_t jobCount = 0;
+std::atomic<size_t> nextJob(0);
+size_t busyWorkers = 0;
+unsigned long long batchNumber = 0;
+bool stopping = false;
+
+void Workers::start(unsigned int count) 
+{
+    stop();
+
+    if(count == 0)
+        count = std::min(std::max(std::thread::hardware_concurrency(), 1u), (unsigned int)MAX_DEFAULT_WORKERS);
+    count = std::min(count, (unsigned int)MAX_RENDER_THREADS);
+
+    stopping = false;
+    for(unsigned int i=1; i<count; i++)
+        threads.emplace_back(workerLoop);
+}
+
+void Workers::stop() 
+{
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+
+    for(std::thread& t : threads)
+        t.join();
+
+    threads.clear();
+}
+
+unsigned int Workers::count() 
+{
+    return threads.size() + 1;
+}
+
+void Workers::run(size_t jobs, const std::function<void(size_t)>& job) 
+{
+    if(threads.empty() || jobs <= 1) {
+        for(size_t i=0; i<jobs; i++)
+            job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        currentJob = &job;
+        jobCount = jobs;
+        nextJob = 0;
+        busyWorkers = threads.size();
+        batchNumber++;
+    }
+    wakeWorkers.notify_all();
+
+    drainJobs(); //help out instead of just waiting
+
+    //every worker has to check in before the batch (and the job it points to) can go away
+    std::unique_lock<std::mutex> lock(poolLock);
+    batchDone.wait(lock, [] { return busyWorkers == 0; });
+    currentJob = nullptr;
+}
+
+void workerLoop() 
+{
+    unsigned long long seenBatch = 0;
+
+    while(true) {
+        std::unique_lock<std::mutex> lock(poolLock);
+        wakeWorkers.wait(lock, [&] { return stopping || batchNumber != seenBatch; });
+
+        if(stopping)
+            return;
+
+        seenBatch = batchNumber;
+        lock.unlock();
+
+        drainJobs();
+
+        lock.lock();
+        if(--busyWorkers == 0)
+            batchDone.notify_one();
+    }
+}
+
+//keep grabbing the next unclaimed job until there are none left
+void drainJobs() 
+{
+    size_t i;
+    while((i = nextJob.fetch_add(1)) < jobCount)
+        (*currentJob)(i);
+}
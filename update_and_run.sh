@@ -10,4 +10,4 @@ else
 	cd build
 fi
 
-sudo ./squiggly
+sudo ./squiggly "$@"